@@ -0,0 +1,192 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "Benchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+using namespace std;
+
+volatile long long benchmarkSink = 0;
+
+static double Now()
+{
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+BenchmarkSuite::BenchmarkSuite()
+{
+	warmup = BENCHMARK_WARMUP;
+	samples = BENCHMARK_SAMPLES;
+}
+
+void BenchmarkSuite::Add(string name, function<void()> body)
+{
+	Entry entry;
+	entry.name = name;
+	entry.body = body;
+	entries.push_back(entry);
+}
+
+void BenchmarkSuite::Run()
+{
+	results.clear();
+	for (int i = 0; i < (int)entries.size(); i++)
+	{
+		if (!filter.empty() && entries[i].name.find(filter) == string::npos)
+			continue;
+
+		BenchmarkResult result = Measure(entries[i]);
+		results.push_back(result);
+
+		char line[256];
+		sprintf(line, "%-32s median %10.2f us  mean %10.2f  stddev %8.2f (%4.1f%%)  [%d x %d, warmup %d]",
+			result.name.c_str(), result.median, result.mean, sqrt(result.variance),
+			result.mean > 0 ? 100*sqrt(result.variance)/result.mean : 0.0, result.samples, result.repeats, result.warmup);
+		cout << line << endl;
+	}
+}
+
+/*
+Each sample times enough runs back to back to take BENCHMARK_MIN_SAMPLE_TIME,
+so the clock's resolution doesn't swamp quick benchmarks.  The warm-up
+samples fill the caches and let the CPU clock up before anything is
+recorded.  The median is what baselines compare, since one sample that got
+interrupted can't move it.
+*/
+BenchmarkResult BenchmarkSuite::Measure(const Entry &entry)
+{
+	BenchmarkResult result;
+	result.name = entry.name;
+	result.warmup = warmup;
+	result.samples = samples > 0 ? samples : 1;
+
+	double start = Now();
+	entry.body();
+	double once = Now() - start;
+	result.repeats = once >= BENCHMARK_MIN_SAMPLE_TIME ? 1 : (int)ceil(BENCHMARK_MIN_SAMPLE_TIME/max(once, 1e-9));
+
+	for (int i = 0; i < warmup; i++)
+		for (int j = 0; j < result.repeats; j++)
+			entry.body();
+
+	vector<double> times(result.samples);
+	for (int i = 0; i < result.samples; i++)
+	{
+		start = Now();
+		for (int j = 0; j < result.repeats; j++)
+			entry.body();
+		times[i] = 1e6*(Now() - start)/result.repeats;
+	}
+
+	sort(times.begin(), times.end());
+	int middle = result.samples/2;
+	result.median = result.samples % 2 ? times[middle] : (times[middle - 1] + times[middle])/2;
+	result.minimum = times.front();
+	result.maximum = times.back();
+
+	result.mean = 0;
+	for (int i = 0; i < result.samples; i++)
+		result.mean += times[i];
+	result.mean /= result.samples;
+
+	result.variance = 0;
+	for (int i = 0; i < result.samples; i++)
+		result.variance += (times[i] - result.mean)*(times[i] - result.mean);
+	result.variance = result.samples > 1 ? result.variance/(result.samples - 1) : 0;
+
+	return result;
+}
+
+bool BenchmarkSuite::WriteJSON(string filename) const
+{
+	ofstream out(filename.c_str());
+	if (!out)
+		return false;
+
+	out << "{" << endl << "\t\"benchmarks\": [" << endl;
+	for (int i = 0; i < (int)results.size(); i++)
+	{
+		const BenchmarkResult &result = results[i];
+		char line[512];
+		sprintf(line, "\t\t{\"name\": \"%s\", \"warmup\": %d, \"samples\": %d, \"repeats\": %d, "
+			"\"median\": %.4f, \"mean\": %.4f, \"variance\": %.4f, \"min\": %.4f, \"max\": %.4f}",
+			result.name.c_str(), result.warmup, result.samples, result.repeats,
+			result.median, result.mean, result.variance, result.minimum, result.maximum);
+		out << line << (i + 1 < (int)results.size() ? "," : "") << endl;
+	}
+	out << "\t]" << endl << "}" << endl;
+	return true;
+}
+
+int BenchmarkSuite::CompareBaseline(string filename, double tolerance) const
+{
+	map<string, double> baseline = ReadBaselineMedians(filename);
+	if (baseline.empty())
+	{
+		cout << "No baseline in " << filename << endl;
+		return 0;
+	}
+
+	int regressions = 0;
+	cout << endl << "Compared with " << filename << ":" << endl;
+	for (int i = 0; i < (int)results.size(); i++)
+	{
+		map<string, double>::iterator found = baseline.find(results[i].name);
+		if (found == baseline.end() || found->second <= 0)
+		{
+			cout << results[i].name << ": not in the baseline" << endl;
+			continue;
+		}
+
+		double change = (results[i].median - found->second)/found->second;
+		const char *verdict = "";
+		if (change > tolerance)
+		{
+			verdict = "  REGRESSION";
+			regressions++;
+		}
+		else if (change < -tolerance)
+			verdict = "  faster";
+
+		char line[256];
+		sprintf(line, "%-32s %10.2f -> %10.2f us  %+6.1f%%%s", results[i].name.c_str(), found->second, results[i].median, 100*change, verdict);
+		cout << line << endl;
+	}
+	return regressions;
+}
+
+//Only reads back what WriteJSON writes: the name and median of each benchmark.
+map<string, double> BenchmarkSuite::ReadBaselineMedians(string filename)
+{
+	map<string, double> medians;
+	ifstream in(filename.c_str());
+	if (!in)
+		return medians;
+	ostringstream contents;
+	contents << in.rdbuf();
+	string json = contents.str();
+
+	size_t pos = 0;
+	while ((pos = json.find("\"name\"", pos)) != string::npos)
+	{
+		size_t open = json.find('"', json.find(':', pos) + 1);
+		size_t close = json.find('"', open + 1);
+		size_t median = json.find("\"median\"", close);
+		if (open == string::npos || close == string::npos || median == string::npos)
+			break;
+
+		string name = json.substr(open + 1, close - open - 1);
+		medians[name] = atof(json.c_str() + json.find(':', median) + 1);
+		pos = close + 1;
+	}
+	return medians;
+}
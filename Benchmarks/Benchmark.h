@@ -0,0 +1,76 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* Benchmark.h
+* Defines a small harness for timing pieces of the library the same way every
+* run, and for comparing the timings against a saved baseline.
+*****************************************************************************/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+using namespace std;
+
+#define BENCHMARK_WARMUP 3 //samples thrown away before measuring
+#define BENCHMARK_SAMPLES 25
+#define BENCHMARK_MIN_SAMPLE_TIME 0.002 //seconds; quick benchmarks are repeated until a sample takes this long
+#define BENCHMARK_TOLERANCE 0.10 //how much slower than the baseline counts as a regression
+
+//Times are per run of the benchmark, in microseconds.
+struct BenchmarkResult
+{
+	string name;
+	int warmup, samples;
+	int repeats; //runs in each sample
+	double median, mean, variance, minimum, maximum;
+};
+
+//Pass results here so the compiler can't throw away the work that made them.
+extern volatile long long benchmarkSink;
+inline void Keep(long long value) { benchmarkSink += value; }
+
+class BenchmarkSuite
+{
+public:
+
+	BenchmarkSuite();
+
+	void Add(string name, function<void()> body);
+
+	void SetWarmup(int warmup) { this->warmup = warmup; }
+	void SetSamples(int samples) { this->samples = samples; }
+	void SetFilter(string filter) { this->filter = filter; } //only run benchmarks with this in their name
+
+	//Run everything, printing each result as it's measured.
+	void Run();
+	const vector<BenchmarkResult> &GetResults() const { return results; }
+
+	bool WriteJSON(string filename) const;
+
+	//Print each result next to its baseline, and return how many got slower by more than tolerance.
+	int CompareBaseline(string filename, double tolerance = BENCHMARK_TOLERANCE) const;
+
+private:
+
+	struct Entry
+	{
+		string name;
+		function<void()> body;
+	};
+
+	BenchmarkResult Measure(const Entry &entry);
+	static map<string, double> ReadBaselineMedians(string filename);
+
+	vector<Entry> entries;
+	vector<BenchmarkResult> results;
+	int warmup, samples;
+	string filter;
+};
+
+#endif
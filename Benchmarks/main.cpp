@@ -0,0 +1,387 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "Benchmark.h"
+#include "../OFLib/ROM.h"
+#include "../OFLib/FlatFile.h"
+#include "../OFLib/Expression.h"
+#include "../OFLib/ChunkedMap.h"
+#include "../OFLib/PathFinder.h"
+#include "../OFLib/Fixtures.h"
+#include "../OFLib/Trace.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+using namespace std;
+
+//Scratch files, written before the benchmarks run and removed afterwards.
+const string FLATFILE_BENCH_FILE = "BenchmarkFlatFile.txt";
+const string EXPRESSION_BENCH_FILE = "BenchmarkExpression.bin";
+const string CHUNKED_MAP_BENCH_FILE = "BenchmarkChunkedMap.map";
+const string BMP_BENCH_FILE = "BenchmarkImage.bmp";
+const string SYNTHETIC_ROM_DIRECTORY = "BenchmarkROM"; //kept between runs, since the same seed always writes the same ROM
+
+void AddROMBenchmarks(BenchmarkSuite &suite, ROM &rom)
+{
+	ROM *r = &rom;
+	suite.Add("ROM load tables", [r]() {
+		Keep(r->LoadMonsters().size());
+		Keep(r->LoadWeapons().size());
+		Keep(r->LoadArmor().size());
+		Keep(r->LoadBattles().size());
+	});
+	suite.Add("ROM map tile decode", [r]() {
+		for (int tile = 0; tile < MAP_TILESET_PATTERN_ENTRIES; tile++)
+		{
+			unsigned char *sprite;
+			r->BuildRGBMapTileSprite(sprite, 0, 0, tile);
+			Keep(sprite[0]);
+			delete[] sprite;
+		}
+	});
+	suite.Add("ROM monster sprite decode", [r]() {
+		for (int pic = 0; pic < 4; pic++)
+		{
+			unsigned char *sprite;
+			r->BuildRGBMonsterSprite(sprite, 0, 0, pic);
+			Keep(sprite[0]);
+			delete[] sprite;
+		}
+	});
+	suite.Add("ROM map RLE decode", [r]() {
+		static vector<int> tileIDs(MAP_WIDTH*MAP_HEIGHT);
+		for (int mapIndex = 0; mapIndex < MAP_ENTRIES; mapIndex++)
+		{
+			r->DecodeMap(mapIndex, &tileIDs[0]);
+			Keep(tileIDs[0]);
+		}
+	});
+	suite.Add("ROM map RLE decode parallel", [r]() {
+		static vector<int> tileIDs(MAP_ENTRIES*MAP_WIDTH*MAP_HEIGHT);
+		r->DecodeAllMaps(&tileIDs[0]);
+		Keep(tileIDs[0]);
+	});
+	suite.Add("ROM overworld RLE decode", [r]() {
+		static vector<int> tileIDs(OVERWORLD_WIDTH*OVERWORLD_HEIGHT);
+		r->DecodeOverworld(&tileIDs[0]);
+		Keep(tileIDs[0]);
+	});
+	suite.Add("ROM reverse index lookups", [r]() {
+		long long sum = 0;
+		for (int monster = 0; monster < MONSTER_ENTRIES; monster++)
+		{
+			Span<BattleSlot> slots = r->GetBattlesWithMonster(monster);
+			for (int i = 0; i < slots.size(); i++)
+				sum += slots[i].battle;
+		}
+		for (int spell = 0; spell < SPELL_ENTRIES; spell++)
+			sum += r->GetMonstersWithSpell(spell).size() + r->GetWeaponsWithSpell(spell).size() + r->GetArmorWithSpell(spell).size();
+		for (int mapIndex = 0; mapIndex < MAP_ENTRIES; mapIndex++)
+			sum += r->GetMapsWithGraphics(mapIndex).size();
+		Keep(sum);
+	});
+	suite.Add("ROM battle atlas build", [r]() {
+		static vector<BattleDef> battles = r->LoadBattles();
+		static BattleAtlas atlas;
+		for (int i = 0; i < BATTLE_ENTRIES; i += 8)
+		{
+			r->BuildBattleAtlas(battles[i], atlas);
+			Keep(atlas.pixels[0]);
+		}
+	});
+	suite.Add("WriteBMPImage 48x48", [r]() {
+		static vector<unsigned char> sprite(3*48*48, 0x80);
+		r->WriteBMPImage(&sprite[0], 48, 48, BMP_BENCH_FILE);
+	});
+}
+
+//A monster table sized file, like the ones the exporter writes.
+void WriteFlatFile()
+{
+	ofstream out(FLATFILE_BENCH_FILE.c_str());
+	out << "MonsterID\tName\tHP\tAttX\tAtt\tAcc\tCrit\tDef\tAgi\tMDef\tInit\tExp\tGold\t"
+		<< "Morale\tType\tAttElem\tAttStat\tElemRes\tElemWeak\tAI\tSprite" << endl;
+	for (int i = 0; i < 1024; i++)
+	{
+		out << i << "\tMONSTER" << i;
+		for (int j = 0; j < 18; j++)
+			out << '\t' << (i*31 + j*7) % 1000;
+		out << "\tMONSTER" << i << ".bmp" << endl;
+	}
+}
+
+//A balanced tree of arithmetic, logical and comparison operators over literals, serialized as in Scripts.txt.
+void WriteExpression(ofstream &out, int depth)
+{
+	static const ExprOp ops[] = { EXPR_OP_PLUS, EXPR_OP_MINUS, EXPR_OP_MULT, EXPR_OP_AND, EXPR_OP_OR, EXPR_OP_XOR, EXPR_OP_GT, EXPR_OP_EQ };
+	if (depth == 0)
+	{
+		char type = EXPR_LITERAL;
+		out.write(&type, 1);
+		int value = 7;
+		out.write((char *)&value, 4);
+		return;
+	}
+	char type = EXPR_BINARY_OP, op = (char)ops[depth % 8];
+	out.write(&type, 1);
+	out.write(&op, 1);
+	WriteExpression(out, depth - 1);
+	WriteExpression(out, depth - 1);
+}
+
+void Usage()
+{
+	cout << "Benchmarks [--rom file] [--filter text] [--warmup n] [--samples n]" << endl
+		<< "           [--json out.json] [--baseline baseline.json] [--tolerance percent] [--trace out.json]" << endl
+		<< "           [--synthetic 1] [--seed n] [--run-length n] [--name-length n]" << endl
+		<< "           [--write-rom directory] [--write-quest root] [--maps n] [--map-width n]" << endl
+		<< "           [--map-height n] [--tilesets n] [--tiles n] [--exits n]" << endl
+		<< "Run from the ROMExporter directory, so the ROM's text tables and palette are found." << endl
+		<< "Without a ROM, or with --synthetic 1, a made-up ROM is written to " << SYNTHETIC_ROM_DIRECTORY << " and used instead." << endl
+		<< "--write-rom and --write-quest only write the fixtures, sized by the other options, and exit." << endl
+		<< "--trace records a timeline of the run for chrome://tracing or Perfetto, which slows it down." << endl;
+}
+
+int main(int argc, char *argv[])
+{
+	BenchmarkSuite suite;
+	string romFilename = "finalfantasy1.nes", jsonFilename, baselineFilename, traceFilename;
+	string romDirectory = ".", writeROM, writeQuest;
+	double tolerance = BENCHMARK_TOLERANCE;
+	bool synthetic = false;
+	SyntheticROMOptions romOptions;
+	SyntheticQuestOptions questOptions;
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if (i + 1 >= argc)
+		{
+			Usage();
+			return 2;
+		}
+		if (arg == "--rom")
+			romFilename = argv[++i];
+		else if (arg == "--filter")
+			suite.SetFilter(argv[++i]);
+		else if (arg == "--warmup")
+			suite.SetWarmup(atoi(argv[++i]));
+		else if (arg == "--samples")
+			suite.SetSamples(atoi(argv[++i]));
+		else if (arg == "--json")
+			jsonFilename = argv[++i];
+		else if (arg == "--baseline")
+			baselineFilename = argv[++i];
+		else if (arg == "--trace")
+			traceFilename = argv[++i];
+		else if (arg == "--tolerance")
+			tolerance = atof(argv[++i])/100;
+		else if (arg == "--synthetic")
+			synthetic = atoi(argv[++i]) != 0;
+		else if (arg == "--seed")
+			romOptions.seed = questOptions.seed = strtoull(argv[++i], NULL, 10);
+		else if (arg == "--run-length")
+			romOptions.runLength = questOptions.runLength = atoi(argv[++i]);
+		else if (arg == "--name-length")
+			romOptions.nameLength = atoi(argv[++i]);
+		else if (arg == "--write-rom")
+			writeROM = argv[++i];
+		else if (arg == "--write-quest")
+			writeQuest = argv[++i];
+		else if (arg == "--maps")
+			questOptions.maps = atoi(argv[++i]);
+		else if (arg == "--map-width")
+			questOptions.mapWidth = atoi(argv[++i]);
+		else if (arg == "--map-height")
+			questOptions.mapHeight = atoi(argv[++i]);
+		else if (arg == "--tilesets")
+			questOptions.tilesets = atoi(argv[++i]);
+		else if (arg == "--tiles")
+			questOptions.tilesPerTileset = atoi(argv[++i]);
+		else if (arg == "--exits")
+			questOptions.exitsPerMap = atoi(argv[++i]);
+		else
+		{
+			Usage();
+			return 2;
+		}
+	}
+
+	if (!writeROM.empty() || !writeQuest.empty())
+	{
+		bool written = true;
+		if (!writeROM.empty())
+		{
+			written &= WriteSyntheticROM(writeROM, SYNTHETIC_ROM_FILENAME, romOptions);
+			cout << "Wrote " << writeROM << "/" << SYNTHETIC_ROM_FILENAME << ": seed " << romOptions.seed
+				<< ", run length " << romOptions.runLength << ", name length " << romOptions.nameLength << endl;
+		}
+		if (!writeQuest.empty())
+		{
+			written &= WriteSyntheticQuest(writeQuest, questOptions);
+			cout << "Wrote " << writeQuest << ": " << questOptions.maps << " maps of " << questOptions.mapWidth << "x" << questOptions.mapHeight
+				<< ", " << questOptions.tilesets << " tilesets of " << questOptions.tilesPerTileset << " tiles, "
+				<< questOptions.exitsPerMap << " exits per map" << endl;
+		}
+		return written ? 0 : 2;
+	}
+
+	WriteFlatFile();
+	suite.Add("FlatFileReader 1024 lines", []() {
+		FlatFileReader reader(FLATFILE_BENCH_FILE);
+		Keep(reader.lines.size());
+	});
+
+	{
+		ofstream out(EXPRESSION_BENCH_FILE.c_str(), ios::out|ios::binary);
+		WriteExpression(out, 10);
+	}
+	static ScriptManager scriptMan;
+	Expression::Initialize(&scriptMan);
+	ifstream expressionFile(EXPRESSION_BENCH_FILE.c_str(), ios::in|ios::binary);
+	Expression *expression = scriptMan.BuildExpression(expressionFile);
+	expressionFile.close();
+	suite.Add("Expression evaluate 1023 nodes", [expression]() {
+		Keep(scriptMan.Evaluate(expression));
+	});
+
+	static vector<int> tiles(MAP_WIDTH*MAP_HEIGHT);
+	for (int i = 0; i < (int)tiles.size(); i++)
+		tiles[i] = (i*13) % MAP_TILESET_PATTERN_ENTRIES;
+	suite.Add("Map tile lookup 64x64", []() {
+		long long sum = 0;
+		for (int y = 0; y < MAP_HEIGHT; y++)
+			for (int x = 0; x < MAP_WIDTH; x++)
+				sum += tiles[MapTileIndex(x - 8, y - 7, MAP_WIDTH, MAP_HEIGHT)];
+		Keep(sum);
+	});
+
+	//A frame's worth of NPC paths between random tiles, on a map a quarter walls, laid in runs like the synthetic maps.
+	static WalkMap walkMap;
+	static vector<PathQuery> pathQueries;
+	{
+		CounterRNG rng(1);
+		vector<int> walls(MAP_WIDTH*MAP_HEIGHT);
+		for (int i = 0; i < (int)walls.size(); )
+		{
+			int wall = rng.Percent(25) ? 1 : 0, length = rng.Range(1, 4);
+			for (int j = 0; j < length && i < (int)walls.size(); j++)
+				walls[i++] = wall;
+		}
+		int props[2] = { 0, TILEPROP_SOLID };
+		walkMap.Build(&walls[0], MAP_WIDTH, MAP_HEIGHT, props, 2);
+		while (pathQueries.size() < 300)
+		{
+			PathQuery query = { rng.Range(0, MAP_WIDTH - 1), rng.Range(0, MAP_HEIGHT - 1), rng.Range(0, MAP_WIDTH - 1), rng.Range(0, MAP_HEIGHT - 1) };
+			if (walkMap.IsWalkable(query.startX, query.startY))
+				pathQueries.push_back(query);
+		}
+	}
+	suite.Add("PathFinder 300 queries 64x64", []() {
+		static PathFinder pathFinder(walkMap);
+		static vector<PathResult> results(pathQueries.size());
+		static vector<unsigned char> steps;
+		steps.clear();
+		pathFinder.ClearCache(); //every one a search, as if they'd all just picked somewhere new to go
+		pathFinder.FindPaths(&pathQueries[0], pathQueries.size(), &results[0], steps);
+		Keep(steps.size());
+	});
+
+	//The same NPCs a frame at a time, each asking for its path from where it's got to, then taking a step.
+	suite.Add("PathFinder 300 walkers per frame", []() {
+		static PathFinder pathFinder(walkMap);
+		static vector<PathQuery> walkers(pathQueries);
+		static vector<unsigned char> steps;
+		for (int i = 0; i < (int)walkers.size(); i++)
+		{
+			PathQuery &walker = walkers[i];
+			if (!pathFinder.FindPath(walker.startX, walker.startY, walker.goalX, walker.goalY, steps) || steps.empty())
+			{
+				//Stuck, or there, so start over.
+				walker = pathQueries[i];
+				continue;
+			}
+			Keep(steps.size());
+
+			switch (steps[0])
+			{
+			case PATH_UP:
+				walker.startY++;
+				break;
+			case PATH_DOWN:
+				walker.startY--;
+				break;
+			case PATH_LEFT:
+				walker.startX--;
+				break;
+			default:
+				walker.startX++;
+				break;
+			}
+		}
+	});
+
+	//Walk the camera diagonally across an overworld sized chunked map, a screen at a time.
+	{
+		vector<int> overworld(OVERWORLD_WIDTH*OVERWORLD_HEIGHT);
+		for (int i = 0; i < (int)overworld.size(); i++)
+			overworld[i] = ((i/OVERWORLD_WIDTH)/8 + (i % OVERWORLD_WIDTH)/8) % 16;
+		ChunkedMap::Write(CHUNKED_MAP_BENCH_FILE, &overworld[0], OVERWORLD_WIDTH, OVERWORLD_HEIGHT);
+	}
+	ChunkedMap *chunks = new ChunkedMap(CHUNKED_MAP_BENCH_FILE);
+	suite.Add("ChunkedMap screen lookup", [chunks]() {
+		static int step = 0;
+		int col = step % OVERWORLD_WIDTH, row = step % OVERWORLD_HEIGHT;
+		step += 16;
+		chunks->Focus(col, row);
+		long long sum = 0;
+		for (int y = 0; y < 16; y++)
+			for (int x = 0; x < 18; x++)
+				sum += chunks->GetTile((col + x) % OVERWORLD_WIDTH, (row + y) % OVERWORLD_HEIGHT);
+		Keep(sum);
+	});
+
+	if (synthetic || !ifstream(romFilename.c_str()))
+	{
+		if (!WriteSyntheticROM(SYNTHETIC_ROM_DIRECTORY, SYNTHETIC_ROM_FILENAME, romOptions))
+		{
+			cout << "Couldn't write a synthetic ROM to " << SYNTHETIC_ROM_DIRECTORY << endl;
+			return 2;
+		}
+		cout << "Using a synthetic ROM (seed " << romOptions.seed << ", run length " << romOptions.runLength
+			<< ", name length " << romOptions.nameLength << ")." << endl;
+		romDirectory = SYNTHETIC_ROM_DIRECTORY;
+		romFilename = SYNTHETIC_ROM_DIRECTORY + "/" + SYNTHETIC_ROM_FILENAME;
+	}
+	ROM *rom = new ROM(romFilename, romDirectory);
+	AddROMBenchmarks(suite, *rom);
+
+	Trace::SetThreadName("Benchmarks");
+	if (!traceFilename.empty())
+		Trace::Start();
+	suite.Run();
+	Trace::Stop();
+
+	int regressions = 0;
+	if (!jsonFilename.empty() && !suite.WriteJSON(jsonFilename))
+		cout << "Couldn't write " << jsonFilename << endl;
+	if (!traceFilename.empty() && !Trace::Write(traceFilename))
+		cout << "Couldn't write " << traceFilename << endl;
+	else if (Trace::GetDropped())
+		cout << Trace::GetDropped() << " trace events didn't fit and were dropped." << endl;
+	if (!baselineFilename.empty())
+		regressions = suite.CompareBaseline(baselineFilename, tolerance);
+
+	delete expression;
+	delete chunks;
+	delete rom;
+	remove(FLATFILE_BENCH_FILE.c_str());
+	remove(EXPRESSION_BENCH_FILE.c_str());
+	remove(CHUNKED_MAP_BENCH_FILE.c_str());
+	remove(BMP_BENCH_FILE.c_str());
+
+	return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,315 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "AssetCache.h"
+#include "Map.h"
+#include "Hash.h"
+#include "MemoryTracker.h"
+#include "Trace.h"
+using namespace std;
+
+AssetCache::AssetCache(size_t budget, AssetLoader *loader)
+{
+	this->budget = budget;
+	this->loader = loader;
+	hits = misses = 0;
+	trimming = false;
+}
+
+AssetCache::~AssetCache()
+{
+	//Maps go first, since they give their tilesets back as they're deleted.
+	trimming = true;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		vector<Entry *> doomed;
+		for (unordered_map<string, Entry *>::iterator i = entries.begin(); i != entries.end(); i++)
+			if ((pass == 0) == (i->second->map != NULL))
+				doomed.push_back(i->second);
+		for (list<Entry *>::iterator i = orphans.begin(); i != orphans.end(); )
+		{
+			if ((pass == 0) == ((*i)->map != NULL))
+			{
+				doomed.push_back(*i);
+				i = orphans.erase(i);
+			}
+			else
+				i++;
+		}
+		for (int i = 0; i < (int)doomed.size(); i++)
+			Free(doomed[i]);
+	}
+}
+
+Tileset *AssetCache::GetTileset(string name, int priority)
+{
+	string key = "Tileset:" + name;
+	Entry *entry = Find(key, priority);
+	if (entry)
+		return entry->tileset;
+
+	entry = new Entry;
+	entry->key = key;
+	if (loader)
+		entry->tileset = loader->LoadTileset(name, priority);
+	else
+	{
+		entry->tileset = new Tileset(name);
+		entry->tileset->ReadSource();
+	}
+	entry->map = NULL;
+	Add(entry);
+	return entry->tileset;
+}
+
+Map *AssetCache::GetMap(string filename, int priority)
+{
+	string key = "Map:" + filename;
+	Entry *entry = Find(key, priority);
+	if (entry)
+		return entry->map;
+
+	entry = new Entry;
+	entry->key = key;
+	entry->tileset = NULL;
+	entry->map = new Map(filename, *this, priority);
+	Add(entry);
+	return entry->map;
+}
+
+//Anything that didn't come from the cache is left alone.
+void AssetCache::Release(Tileset *tileset)
+{
+	Entry *entry = GetOwner(tileset);
+	if (entry)
+		Release(entry);
+}
+
+void AssetCache::Release(Map *map)
+{
+	Entry *entry = GetOwner(map);
+	if (entry)
+		Release(entry);
+}
+
+AssetCache::Entry *AssetCache::GetOwner(const void *asset) const
+{
+	unordered_map<const void *, Entry *>::const_iterator owner = owners.find(asset);
+	return owner == owners.end() ? NULL : owner->second;
+}
+
+//Look for a loaded asset, taking a reference to it if it's there.
+AssetCache::Entry *AssetCache::Find(string key, int priority)
+{
+	unordered_map<string, Entry *>::iterator found = entries.find(key);
+	if (found == entries.end())
+	{
+		misses++;
+		return NULL;
+	}
+
+	Entry *entry = found->second;
+	if (entry->listed)
+	{
+		unused.erase(entry->unused);
+		entry->listed = false;
+	}
+	entry->refs++;
+	hits++;
+	if (priority == ASSET_PRIORITY_HIGH && !IsLoaded(entry))
+		Promote(entry);
+	return entry;
+}
+
+void AssetCache::Promote(Entry *entry)
+{
+	if (!loader)
+		return;
+
+	if (entry->tileset)
+		loader->Promote(entry->tileset);
+	else
+	{
+		loader->Promote(entry->map);
+		Entry *outside = GetOwner(entry->map->outsideTileset), *inside = GetOwner(entry->map->insideTileset);
+		if (outside)
+			Promote(outside);
+		if (inside)
+			Promote(inside);
+	}
+}
+
+void AssetCache::Add(Entry *entry)
+{
+	entry->refs = 1;
+	entry->listed = false;
+	entries[entry->key] = entry;
+	owners[entry->tileset ? (const void *)entry->tileset : (const void *)entry->map] = entry;
+	Trim();
+}
+
+void AssetCache::Release(Entry *entry)
+{
+	if (--entry->refs > 0)
+		return;
+
+	//Nobody wants it any more, so if it hasn't started loading, don't bother.
+	//A map gives its tilesets back as it's deleted, so theirs get cancelled too.
+	if (loader && !IsLoaded(entry) && loader->Cancel(entry->tileset ? (const void *)entry->tileset : (const void *)entry->map))
+	{
+		Free(entry);
+		return;
+	}
+
+	//Replaced while it was in use, so nothing can ask for it again.
+	if (entry->key.empty())
+	{
+		Discard(entry);
+		return;
+	}
+
+	unused.push_front(entry);
+	entry->unused = unused.begin();
+	entry->listed = true;
+	Trim();
+}
+
+void AssetCache::CheckFiles()
+{
+	TRACE_SCOPE("assets", "AssetCache::CheckFiles");
+
+	//Anything still loading will read its files when it's done, so only what's loaded is checked.
+	vector<Entry *> changed;
+	for (unordered_map<string, Entry *>::iterator i = entries.begin(); i != entries.end(); i++)
+	{
+		Entry *entry = i->second;
+		if (!IsLoaded(entry))
+			continue;
+
+		//Files that were only touched don't need loading again.
+		FileSource &source = entry->tileset ? entry->tileset->GetSource() : entry->map->source;
+		unsigned long long stamp = StampFiles(source.files);
+		if (stamp == source.stamp)
+			continue;
+		if (HashFiles(source.files) == source.hash)
+			source.stamp = stamp;
+		else
+			changed.push_back(entry);
+	}
+
+	//Whoever still has an old one can keep it until they let go.
+	for (int i = 0; i < (int)changed.size(); i++)
+	{
+		Entry *entry = changed[i];
+		entries.erase(entry->key);
+		entry->key.clear();
+		if (entry->refs == 0)
+			Discard(entry);
+	}
+}
+
+void AssetCache::Trim()
+{
+	//Freeing a map releases its tilesets, which lands back here.
+	if (trimming)
+		return;
+	trimming = true;
+
+	//Whatever was only waiting to finish loading can go now.
+	for (list<Entry *>::iterator orphan = orphans.begin(); orphan != orphans.end(); )
+	{
+		Entry *entry = *orphan;
+		if (IsLoaded(entry))
+		{
+			orphan = orphans.erase(orphan);
+			Free(entry);
+		}
+		else
+			orphan++;
+	}
+
+	MemoryTracker &tracker = MemoryTracker::Get();
+	size_t used = GetBytesUsed();
+	list<Entry *>::iterator next = unused.end();
+	while ((used > budget || tracker.IsOverBudget()) && next != unused.begin())
+	{
+		next--;
+		Entry *entry = *next;
+		if (!IsLoaded(entry))
+			continue;
+
+		//Throwing out a map doesn't help the tilesets' budget, or the other way around.
+		if (used <= budget && !tracker.IsOverBudget(GetSubsystem(entry)))
+			continue;
+
+		used -= GetBytes(entry);
+		next = unused.erase(next);
+		entry->listed = false;
+		Free(entry);
+	}
+
+	trimming = false;
+}
+
+//Get rid of something nobody can ask for again, once nothing's loading into it.
+void AssetCache::Discard(Entry *entry)
+{
+	if (IsLoaded(entry))
+	{
+		Free(entry);
+		return;
+	}
+
+	if (entry->listed)
+	{
+		unused.erase(entry->unused);
+		entry->listed = false;
+	}
+	orphans.push_back(entry);
+}
+
+void AssetCache::Free(Entry *entry)
+{
+	if (entry->listed)
+		unused.erase(entry->unused);
+	if (!entry->key.empty())
+		entries.erase(entry->key);
+
+	if (entry->tileset)
+	{
+		owners.erase(entry->tileset);
+		delete entry->tileset;
+	}
+	if (entry->map)
+	{
+		owners.erase(entry->map);
+		delete entry->map;
+	}
+	delete entry;
+}
+
+size_t AssetCache::GetBytesUsed() const
+{
+	size_t used = 0;
+	for (unordered_map<string, Entry *>::const_iterator i = entries.begin(); i != entries.end(); i++)
+		used += GetBytes(i->second);
+	return used;
+}
+
+size_t AssetCache::GetBytes(const Entry *entry) const
+{
+	return entry->tileset ? entry->tileset->GetByteSize() : entry->map->GetByteSize();
+}
+
+bool AssetCache::IsLoaded(const Entry *entry) const
+{
+	return entry->tileset ? entry->tileset->IsComplete() : entry->map->IsReady();
+}
+
+int AssetCache::GetSubsystem(const Entry *entry) const
+{
+	return entry->tileset ? MEMORY_TILESETS : MEMORY_MAPS;
+}
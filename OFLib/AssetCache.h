@@ -0,0 +1,115 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* AssetCache.h
+* Defines a cache of loaded tilesets and maps, shared by everything that
+* uses them and kept around after they're done with, up to a memory budget.
+*****************************************************************************/
+
+#ifndef ASSETCACHE_H
+#define ASSETCACHE_H
+
+#include "Tileset.h"
+#include "AssetLoader.h"
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+using namespace std;
+
+class Map;
+
+#define DEFAULT_ASSET_BUDGET (64*1024*1024) //bytes
+
+/* Get* hands out a tileset or map and counts a reference to it, and Release
+   gives the reference back.  Nothing is freed when its last reference goes;
+   it moves to the front of the unused list instead, and the ones at the back
+   are only thrown out when the cache is over budget.  Something that's still
+   loading is never freed; if it can't be kept, it waits on the orphan list
+   until its load is done, and the next Trim frees it.
+
+   Releasing the last reference to something that's still waiting to load
+   cancels the load, so a guess at what will be needed next costs nothing if
+   it turns out wrong.  Asking for something at high priority that was
+   asked for at low priority moves it up.
+
+   Each asset remembers the files it came from, which for a tileset is its
+   index and every tile in it, along with a hash of what they held.  The
+   loader reads them as it loads the asset, so nothing is hashed on the
+   thread asking for it, and a lookup never touches the disk.  CheckFiles
+   looks for assets that changed on disk, so they get loaded again instead
+   of reused.
+
+   Besides its own budget, the cache keeps to every budget set on the
+   MemoryTracker.  A subsystem over its budget only gives up its own unused
+   assets; an overall budget can take any of them.
+
+   If the cache has a loader, everything is loaded through it in the
+   background; otherwise it's loaded on the spot. */
+class AssetCache
+{
+public:
+
+	AssetCache(size_t budget = DEFAULT_ASSET_BUDGET, AssetLoader *loader = NULL);
+	~AssetCache();
+
+	Tileset *GetTileset(string name, int priority = ASSET_PRIORITY_HIGH);
+	Map *GetMap(string filename, int priority = ASSET_PRIORITY_HIGH);
+	void Release(Tileset *tileset);
+	void Release(Map *map);
+
+	void SetBudget(size_t budget) { this->budget = budget; Trim(); }
+	size_t GetBudget() const { return budget; }
+	size_t GetBytesUsed() const;
+
+	//Forget every loaded asset whose files changed, so the next Get loads it again.  It stats every
+	//file, and reads any whose size or modification time changed, so only call it on a reload.
+	void CheckFiles();
+
+	//Throw out the least recently used assets until everything fits the budgets.  Assets grow as
+	//they're uploaded, so whoever runs the uploads should call this after them.
+	void Trim();
+
+	AssetLoader *GetLoader() { return loader; }
+
+	//How many times an asset was asked for and found already loaded, or had to be loaded.
+	int GetHits() const { return hits; }
+	int GetMisses() const { return misses; }
+
+private:
+
+	struct Entry
+	{
+		string key;
+		Tileset *tileset; //one of these two is set
+		Map *map;
+		int refs;
+		bool listed; //on the unused list
+		list<Entry *>::iterator unused; //where, if it is
+	};
+
+	Entry *Find(string key, int priority);
+	Entry *GetOwner(const void *asset) const;
+	void Promote(Entry *entry);
+	void Add(Entry *entry);
+	void Release(Entry *entry);
+	void Discard(Entry *entry);
+	void Free(Entry *entry);
+	size_t GetBytes(const Entry *entry) const;
+	bool IsLoaded(const Entry *entry) const;
+	int GetSubsystem(const Entry *entry) const;
+
+	size_t budget;
+	AssetLoader *loader;
+
+	unordered_map<string, Entry *> entries;
+	unordered_map<const void *, Entry *> owners; //from a handed out asset back to its entry
+	list<Entry *> unused; //most recently released first
+	list<Entry *> orphans; //not wanted any more, but still loading
+	int hits, misses;
+	bool trimming;
+};
+
+#endif
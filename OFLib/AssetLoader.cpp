@@ -0,0 +1,217 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "AssetLoader.h"
+#include "Map.h"
+#include "Trace.h"
+#include <chrono>
+using namespace std;
+
+AssetLoader::AssetLoader(int workerCount)
+{
+	if (workerCount < 1)
+		workerCount = 1;
+
+	stopping = false;
+	outstanding = 0;
+	nextQueue = 0;
+	for (int i = 0; i < workerCount; i++)
+		decoded.push_back(new SPSCQueue<Decoded>(ASSET_QUEUE_SIZE));
+	for (int i = 0; i < workerCount; i++)
+		workers.push_back(thread(&AssetLoader::WorkerLoop, this, i));
+}
+
+AssetLoader::~AssetLoader()
+{
+	{
+		lock_guard<mutex> lock(jobLock);
+		stopping = true;
+	}
+	jobReady.notify_all();
+	for (int i = 0; i < (int)workers.size(); i++)
+		workers[i].join();
+
+	//Throw away whatever never got uploaded.
+	for (int i = 0; i < (int)decoded.size(); i++)
+	{
+		Decoded item;
+		while (decoded[i]->Pop(item))
+			Tileset::FreeImage(item.image);
+		delete decoded[i];
+	}
+}
+
+Tileset *AssetLoader::LoadTileset(string path, int priority)
+{
+	Job job;
+	job.type = ASSET_TILESET;
+	job.path = path;
+	job.tileset = new Tileset();
+	job.tileset->SetName(path);
+	job.map = NULL;
+	AddJob(job, priority);
+
+	return job.tileset;
+}
+
+void AssetLoader::LoadMapTiles(Map *map, string filename, int priority)
+{
+	Job job;
+	job.type = ASSET_MAP;
+	job.path = filename;
+	job.tileset = NULL;
+	job.map = map;
+	AddJob(job, priority);
+}
+
+void AssetLoader::AddJob(const Job &job, int priority)
+{
+	outstanding++;
+	{
+		lock_guard<mutex> lock(jobLock);
+		jobs[priority].push_back(job);
+	}
+	jobReady.notify_one();
+}
+
+//Call with jobLock held.
+bool AssetLoader::FindJob(const void *asset, int priority, deque<Job>::iterator &found)
+{
+	for (found = jobs[priority].begin(); found != jobs[priority].end(); found++)
+		if (found->tileset == asset || found->map == asset)
+			return true;
+	return false;
+}
+
+void AssetLoader::Promote(const void *asset)
+{
+	lock_guard<mutex> lock(jobLock);
+	deque<Job>::iterator found;
+	if (FindJob(asset, ASSET_PRIORITY_LOW, found))
+	{
+		jobs[ASSET_PRIORITY_HIGH].push_back(*found);
+		jobs[ASSET_PRIORITY_LOW].erase(found);
+	}
+}
+
+bool AssetLoader::Cancel(const void *asset)
+{
+	lock_guard<mutex> lock(jobLock);
+	for (int priority = 0; priority < ASSET_PRIORITIES; priority++)
+	{
+		deque<Job>::iterator found;
+		if (FindJob(asset, priority, found))
+		{
+			jobs[priority].erase(found);
+			outstanding--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void AssetLoader::WorkerLoop(int worker)
+{
+	Trace::SetThreadName("Asset loader");
+	while (true)
+	{
+		Job job;
+		{
+			unique_lock<mutex> lock(jobLock);
+			while (!stopping && jobs[ASSET_PRIORITY_HIGH].empty() && jobs[ASSET_PRIORITY_LOW].empty())
+				jobReady.wait(lock);
+			if (stopping)
+				return;
+			deque<Job> &next = jobs[ASSET_PRIORITY_HIGH].empty() ? jobs[ASSET_PRIORITY_LOW] : jobs[ASSET_PRIORITY_HIGH];
+			job = next.front();
+			next.pop_front();
+		}
+
+		Decoded item;
+		item.type = job.type;
+		item.tileset = job.tileset;
+		item.map = job.map;
+		item.image.pixels = NULL;
+		item.last = false;
+
+		if (job.type == ASSET_TILESET)
+		{
+			vector<TileImage> images;
+			Tileset::Decode(job.path, images);
+			for (int i = 0; i < (int)images.size(); i++)
+			{
+				item.image = images[i];
+				Deliver(worker, item);
+			}
+			item.image.pixels = NULL;
+			job.tileset->ReadSource();
+		}
+		else
+		{
+			job.map->LoadTiles(job.path);
+			job.map->ReadSource();
+		}
+
+		item.last = true;
+		Deliver(worker, item);
+	}
+}
+
+//Hand an item to the render thread, waiting for room if it has fallen behind.
+void AssetLoader::Deliver(int worker, const Decoded &item)
+{
+	while (!decoded[worker]->Push(item))
+	{
+		if (stopping)
+		{
+			TileImage image = item.image;
+			Tileset::FreeImage(image);
+			return;
+		}
+		this_thread::yield();
+	}
+}
+
+void AssetLoader::Upload(float budget)
+{
+	TRACE_SCOPE("assets", "AssetLoader::Upload");
+	if (outstanding == 0)
+		return;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	int queueCount = decoded.size();
+	int emptyQueues = 0;
+	while (emptyQueues < queueCount)
+	{
+		Decoded item;
+		SPSCQueue<Decoded> *queue = decoded[nextQueue];
+		nextQueue = (nextQueue + 1) % queueCount;
+		if (!queue->Pop(item))
+		{
+			emptyQueues++;
+			continue;
+		}
+		emptyQueues = 0;
+
+		if (item.type == ASSET_TILESET && item.image.pixels)
+		{
+			item.tileset->Upload(item.image);
+			Tileset::FreeImage(item.image);
+		}
+		if (item.last)
+		{
+			if (item.type == ASSET_TILESET)
+				item.tileset->MarkComplete();
+			else
+				item.map->tilesLoaded = true;
+			outstanding--;
+		}
+
+		chrono::duration<float, milli> elapsed = chrono::steady_clock::now() - start;
+		if (elapsed.count() >= budget)
+			break;
+	}
+}
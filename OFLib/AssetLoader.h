@@ -0,0 +1,115 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* AssetLoader.h
+* Defines a loader that reads tilesets and maps on worker threads, and
+* hands them to the render thread to be uploaded a little at a time.
+*****************************************************************************/
+
+#ifndef ASSETLOADER_H
+#define ASSETLOADER_H
+
+#include "Tileset.h"
+#include "SPSCQueue.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+using namespace std;
+
+class Map;
+
+#define ASSET_QUEUE_SIZE 256 //decoded items waiting per worker
+#define DEFAULT_UPLOAD_BUDGET 4.0f //milliseconds of uploading per frame
+
+enum AssetType
+{
+	ASSET_TILESET,
+	ASSET_MAP
+};
+
+//Workers only pick up low priority jobs when there's nothing else to do.
+enum AssetPriority
+{
+	ASSET_PRIORITY_HIGH,
+	ASSET_PRIORITY_LOW,
+	ASSET_PRIORITIES
+};
+
+/* Jobs go to the workers through an ordinary locked queue, since there are
+   only a few per map.  What they decode comes back through a lock-free queue
+   per worker, so each one has a single producer and the render thread never
+   waits on a worker.
+
+   Anything handed out by the loader has to stay alive until it is done
+   loading. */
+class AssetLoader
+{
+public:
+
+	AssetLoader(int workerCount = 1);
+	~AssetLoader();
+
+	//Start reading a tileset.  It fills in as Upload runs, and can be used once it IsComplete().
+	Tileset *LoadTileset(string path, int priority = ASSET_PRIORITY_HIGH);
+
+	//Start reading a map's tiles from a file.
+	void LoadMapTiles(Map *map, string filename, int priority = ASSET_PRIORITY_HIGH);
+
+	//Move a low priority tileset or map up, if no worker has picked it up yet.
+	void Promote(const void *asset);
+
+	//Take back the job for a tileset or map if no worker has picked it up yet.
+	//Returns false if it's already on its way, in which case it has to be left to finish.
+	bool Cancel(const void *asset);
+
+	//Upload what the workers have decoded until budget milliseconds have gone by.
+	//Render thread only.  At least one item is uploaded each call, so loading always moves along.
+	void Upload(float budget = DEFAULT_UPLOAD_BUDGET);
+
+	//Whether anything is still loading.
+	bool IsBusy() const { return outstanding > 0; }
+
+private:
+
+	struct Job
+	{
+		AssetType type;
+		string path;
+		Tileset *tileset;
+		Map *map;
+	};
+
+	//A decoded tile, or the marker that a job is finished.
+	struct Decoded
+	{
+		AssetType type;
+		Tileset *tileset;
+		Map *map;
+		TileImage image;
+		bool last;
+	};
+
+	void AddJob(const Job &job, int priority);
+	bool FindJob(const void *asset, int priority, deque<Job>::iterator &found);
+	void WorkerLoop(int worker);
+	void Deliver(int worker, const Decoded &item);
+
+	vector<thread> workers;
+	vector<SPSCQueue<Decoded> *> decoded; //one per worker
+	int nextQueue; //where Upload looks first, so no worker gets starved
+
+	deque<Job> jobs[ASSET_PRIORITIES];
+	mutex jobLock;
+	condition_variable jobReady;
+	atomic<bool> stopping;
+
+	int outstanding; //jobs not yet fully uploaded, render thread only
+};
+
+#endif
@@ -0,0 +1,77 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "Battle.h"
+
+BattlePool::BattlePool(const vector<Monster> &monsters, int capacity)
+{
+	this->monsters = &monsters;
+	nextBlockSize = capacity < 1 ? 1 : capacity;
+}
+
+BattlePool::~BattlePool()
+{
+	for (int i = 0; i < (int)blocks.size(); i++)
+		delete[] blocks[i];
+}
+
+Battle *BattlePool::Acquire()
+{
+	if (freeList.empty())
+	{
+		//Grow by a whole block at a time, doubling each time we run out.
+		Battle *block = new Battle[nextBlockSize];
+		blocks.push_back(block);
+		freeList.reserve(freeList.size() + nextBlockSize);
+		for (int i = nextBlockSize - 1; i >= 0; i--)
+			freeList.push_back(&block[i]);
+		nextBlockSize *= 2;
+	}
+
+	Battle *battle = freeList.back();
+	freeList.pop_back();
+	return battle;
+}
+
+void BattlePool::End(Battle *battle)
+{
+	//The free list always has room for every battle we've allocated.
+	freeList.push_back(battle);
+}
+
+void BattlePool::AddEnemies(Battle *battle, int monster, int count)
+{
+	int hpMax = (*monsters)[monster].hpMax;
+	for (int i = 0; i < count && battle->enemyCount < MAX_ENEMIES; i++)
+	{
+		Enemy &enemy = battle->enemies[battle->enemyCount++];
+		enemy.monster = monster;
+		enemy.hp = hpMax;
+		enemy.status = 0;
+		enemy.spellIndex = 0;
+		enemy.abilIndex = 0;
+	}
+}
+
+//How many small and large monsters fit in each formation.
+void BattlePool::FormationSlots(BattleFormation formation, int &small, int &large)
+{
+	switch (formation)
+	{
+	case FORM_SMALL:
+		small = 9; large = 0;
+		break;
+	case FORM_LARGE:
+		small = 0; large = 4;
+		break;
+	case FORM_MIXED:
+		small = 6; large = 2;
+		break;
+	default:
+		small = 0; large = 1;
+		break;
+	}
+}
@@ -0,0 +1,103 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* Battle.h
+* Defines a battle in progress, and a pool that hands out battles without
+* allocating memory once it has warmed up.
+*****************************************************************************/
+
+#ifndef BATTLE_H
+#define BATTLE_H
+
+#include "Monster.h"
+#include "BattleDef.h"
+#include <vector>
+using namespace std;
+
+#define MAX_ENEMIES 9 //the most enemies any formation can hold
+
+//The enemies in one battle.  Everything is stored inline, so battles can be
+//reused without touching the heap.
+class Battle
+{
+public:
+
+	const BattleDef *def;
+	bool alternate; //using the alternate formation
+	Enemy enemies[MAX_ENEMIES];
+	int enemyCount;
+};
+
+
+
+/* Battles are kept on a free list.  Ending a battle puts it back on the list,
+   and the pool only allocates when more battles are running at once than
+   ever before.  Enemies refer to the pool's monster table by index. */
+class BattlePool
+{
+public:
+
+	BattlePool(const vector<Monster> &monsters, int capacity = 16);
+	~BattlePool();
+
+	//Set up a battle from a formation, rolling the number of each monster
+	//the same way the game does.
+	template <class RNG>
+	Battle *Begin(const BattleDef &def, RNG &rng, bool alternate = false)
+	{
+		Battle *battle = Acquire();
+		battle->def = &def;
+		battle->alternate = alternate;
+		battle->enemyCount = 0;
+
+		//Bosses always appear alone.
+		if (def.formation == FORM_FIEND || def.formation == FORM_CHAOS)
+		{
+			AddEnemies(battle, def.monsters[0], 1);
+			return battle;
+		}
+
+		int smallLeft, largeLeft;
+		FormationSlots(def.formation, smallLeft, largeLeft);
+
+		//The alternate formation only has the first two groups.
+		int groups = alternate ? 2 : 4;
+		for (int i = 0; i < groups; i++)
+		{
+			int qty = alternate ? i + 4 : i;
+			if (def.qtyMax[qty] == 0)
+				continue;
+			int count = rng.Range(def.qtyMin[qty], def.qtyMax[qty]);
+
+			//Only as many as there is room for.
+			int &slotsLeft = (def.monsterPics[i] < 2) ? smallLeft : largeLeft;
+			if (count > slotsLeft)
+				count = slotsLeft;
+			slotsLeft -= count;
+
+			AddEnemies(battle, def.monsters[i], count);
+		}
+
+		return battle;
+	}
+
+	//Return a battle to the pool.
+	void End(Battle *battle);
+
+	const Monster &GetMonster(const Enemy &enemy) const { return (*monsters)[enemy.monster]; }
+
+private:
+
+	Battle *Acquire();
+	void AddEnemies(Battle *battle, int monster, int count);
+	static void FormationSlots(BattleFormation formation, int &small, int &large);
+
+	const vector<Monster> *monsters;
+	vector<Battle *> blocks; //every allocation, for cleanup
+	vector<Battle *> freeList;
+	int nextBlockSize;
+};
+
+#endif
@@ -0,0 +1,185 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "BattleScene.h"
+#include "Battle.h"
+#include "RenderStats.h"
+#include "MemoryTracker.h"
+#include <cstring>
+#include <SDL/SDL_opengl.h>
+using namespace std;
+
+//The slots each formation has, as top left corners in the enemy area.
+static const int SMALL_SLOTS[9][2] = {
+	{ 0, 0 }, { 0, 32 }, { 0, 64 }, { 32, 0 }, { 32, 32 }, { 32, 64 }, { 64, 0 }, { 64, 32 }, { 64, 64 } };
+static const int LARGE_SLOTS[4][2] = { { 0, 0 }, { 0, 48 }, { 48, 0 }, { 48, 48 } };
+static const int MIXED_LARGE_SLOTS[2][2] = { { 0, 0 }, { 0, 48 } };
+static const int MIXED_SMALL_SLOTS[6][2] = { { 48, 0 }, { 48, 32 }, { 48, 64 }, { 80, 0 }, { 80, 32 }, { 80, 64 } };
+
+BattleScene::BattleScene()
+{
+	memset(&atlas, 0, sizeof(atlas));
+	texture = 0;
+	uploaded = false;
+	MemoryTracker::Get().Allocate(MEMORY_BATTLES, MEMORY_CPU, "Battle atlas", sizeof(atlas));
+}
+
+BattleScene::~BattleScene()
+{
+	MemoryTracker::Get().Free(MEMORY_BATTLES, MEMORY_CPU, "Battle atlas", sizeof(atlas));
+	if (texture)
+	{
+		glDeleteTextures(1, &texture);
+		MemoryTracker::Get().Free(MEMORY_BATTLES, MEMORY_GPU, "Battle atlas", MemoryTracker::TextureBytes(BATTLE_ATLAS_SIZE, BATTLE_ATLAS_SIZE, 4, false));
+	}
+}
+
+void BattleScene::Set(const Battle &battle, const BattleAtlas &atlas)
+{
+	this->atlas = atlas;
+	uploaded = false;
+	Layout(battle, sprites);
+}
+
+void BattleScene::Layout(const Battle &battle, vector<BattleSprite> &sprites)
+{
+	sprites.clear();
+	const BattleDef &def = *battle.def;
+
+	if (def.formation == FORM_FIEND || def.formation == FORM_CHAOS)
+	{
+		BattleSprite boss = { BATTLE_SCENE_MARGIN, BATTLE_SCENE_MARGIN, 0 };
+		sprites.push_back(boss);
+		return;
+	}
+
+	const int (*smallSlots)[2] = SMALL_SLOTS, (*largeSlots)[2] = LARGE_SLOTS;
+	int smallCount = 0, largeCount = 0;
+	switch (def.formation)
+	{
+	case FORM_SMALL:
+		smallCount = 9;
+		break;
+	case FORM_LARGE:
+		largeCount = 4;
+		break;
+	default:
+		smallSlots = MIXED_SMALL_SLOTS; smallCount = 6;
+		largeSlots = MIXED_LARGE_SLOTS; largeCount = 2;
+		break;
+	}
+
+	//Enemies only know their monster, so find the group it came from.
+	int groups = battle.alternate ? 2 : BATTLE_GROUPS;
+	int smallUsed = 0, largeUsed = 0;
+	for (int i = 0; i < battle.enemyCount; i++)
+	{
+		int group = 0;
+		while (group < groups - 1 && def.monsters[group] != battle.enemies[i].monster)
+			group++;
+
+		BattleSprite sprite;
+		sprite.group = group;
+		if (def.monsterPics[group] < 2)
+		{
+			if (smallUsed == smallCount)
+				continue;
+			sprite.x = BATTLE_SCENE_MARGIN + smallSlots[smallUsed][0];
+			sprite.y = BATTLE_SCENE_MARGIN + smallSlots[smallUsed][1];
+			smallUsed++;
+		}
+		else
+		{
+			if (largeUsed == largeCount)
+				continue;
+			sprite.x = BATTLE_SCENE_MARGIN + largeSlots[largeUsed][0];
+			sprite.y = BATTLE_SCENE_MARGIN + largeSlots[largeUsed][1];
+			largeUsed++;
+		}
+		sprites.push_back(sprite);
+	}
+}
+
+void BattleScene::Draw(float left, float top, float pixelSize)
+{
+	if (!texture)
+	{
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, BATTLE_ATLAS_SIZE, BATTLE_ATLAS_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, atlas.pixels);
+		renderStats.textureBinds++;
+		renderStats.uploadedBytes += sizeof(atlas.pixels);
+		MemoryTracker::Get().Allocate(MEMORY_BATTLES, MEMORY_GPU, "Battle atlas", MemoryTracker::TextureBytes(BATTLE_ATLAS_SIZE, BATTLE_ATLAS_SIZE, 4, false));
+		uploaded = true;
+	}
+	glBindTexture(GL_TEXTURE_2D, texture);
+	renderStats.textureBinds++;
+	if (!uploaded)
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, BATTLE_ATLAS_SIZE, BATTLE_ATLAS_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, atlas.pixels);
+		renderStats.uploadedBytes += sizeof(atlas.pixels);
+		uploaded = true;
+	}
+
+	//The atlas has no partly clear pixels, so an alpha test does instead of blending.
+	glPushAttrib(GL_ENABLE_BIT);
+	glEnable(GL_ALPHA_TEST);
+	glAlphaFunc(GL_GREATER, 0.5f);
+
+	//Atlas rows go from the top down, like the enemy area, but GL's y goes up.
+	const float texel = 1.0f/BATTLE_ATLAS_SIZE;
+	glBegin(GL_QUADS);
+	for (int i = 0; i < (int)sprites.size(); i++)
+	{
+		const AtlasRect &rect = atlas.groups[sprites[i].group];
+		float x0 = left + sprites[i].x*pixelSize, x1 = x0 + rect.width*pixelSize;
+		float y0 = top - sprites[i].y*pixelSize, y1 = y0 - rect.height*pixelSize;
+		float s0 = rect.x*texel, s1 = (rect.x + rect.width)*texel;
+		float t0 = rect.y*texel, t1 = (rect.y + rect.height)*texel;
+
+		glTexCoord2f(s0, t1);
+		glVertex2f(x0, y1);
+		glTexCoord2f(s0, t0);
+		glVertex2f(x0, y0);
+		glTexCoord2f(s1, t0);
+		glVertex2f(x1, y0);
+		glTexCoord2f(s1, t1);
+		glVertex2f(x1, y1);
+	}
+	glEnd();
+	renderStats.drawCalls++;
+
+	glPopAttrib();
+}
+
+void BattleScene::Render(unsigned char *rgb, int width, int height, int left, int top) const
+{
+	for (int i = 0; i < (int)sprites.size(); i++)
+	{
+		const AtlasRect &rect = atlas.groups[sprites[i].group];
+		for (int y = 0; y < rect.height; y++)
+		{
+			int row = top + sprites[i].y + y;
+			if (row < 0 || row >= height)
+				continue;
+			const unsigned char *src = &atlas.pixels[4*((rect.y + y)*BATTLE_ATLAS_SIZE + rect.x)];
+			for (int x = 0; x < rect.width; x++, src += 4)
+			{
+				int col = left + sprites[i].x + x;
+				if (col < 0 || col >= width || !src[3])
+					continue;
+				unsigned char *dest = &rgb[3*(row*width + col)];
+				dest[0] = src[0];
+				dest[1] = src[1];
+				dest[2] = src[2];
+			}
+		}
+	}
+}
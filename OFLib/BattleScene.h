@@ -0,0 +1,86 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* BattleScene.h
+* Defines the enemy side of a battle screen: every enemy graphic a battle
+* uses packed into one atlas, the formation laid out in slots, and a renderer
+* that draws the whole group at once on GL or into an image on the CPU.
+*****************************************************************************/
+
+#ifndef BATTLESCENE_H
+#define BATTLESCENE_H
+
+#include "BattleDef.h"
+#include <vector>
+using namespace std;
+
+class Battle;
+
+#define BATTLE_ATLAS_SIZE 128 //pixels on a side; Chaos, the biggest graphic, is 112x96
+#define BATTLE_ATLAS_CELL 48 //each group's graphic gets a cell the size of a large monster
+#define BATTLE_GROUPS 4 //graphics a battle can use
+
+#define BATTLE_SCENE_WIDTH 128 //the enemy area, in pixels
+#define BATTLE_SCENE_HEIGHT 112
+#define BATTLE_SCENE_MARGIN 8
+
+#define BATTLE_SMALL_SIZE 32
+#define BATTLE_LARGE_SIZE 48
+
+//Where a graphic is in the atlas.
+struct AtlasRect
+{
+	int x, y, width, height;
+};
+
+/* Everything a battle draws its enemies from.  This is plain memory, built
+   by ROM::BuildBattleAtlas without touching GL, so it can be made ahead of
+   time on any thread and a battle starting only has to upload it. */
+struct BattleAtlas
+{
+	unsigned char pixels[BATTLE_ATLAS_SIZE*BATTLE_ATLAS_SIZE*4]; //RGBA, from the top row down; color 0 is clear
+	AtlasRect groups[BATTLE_GROUPS]; //by group in the BattleDef; a boss only uses the first
+	int groupCount;
+};
+
+//One enemy on screen, in pixels from the top left of the enemy area.
+struct BattleSprite
+{
+	int x, y;
+	int group;
+};
+
+class BattleScene
+{
+public:
+
+	BattleScene();
+	~BattleScene();
+
+	//Lay out a battle's enemies, and take a copy of its atlas.
+	void Set(const Battle &battle, const BattleAtlas &atlas);
+	const vector<BattleSprite> &GetSprites() const { return sprites; }
+
+	/* Draw every enemy with one texture and one batch of quads, with (left, top)
+	   the top left of the enemy area and each atlas pixel pixelSize units
+	   across.  The texture is made on the first Draw and reused from battle to
+	   battle, so nothing touches GL until then. */
+	void Draw(float left, float top, float pixelSize);
+
+	//The same picture, drawn over an RGB image (width*height, top row first) with the enemy area at (left, top).
+	void Render(unsigned char *rgb, int width, int height, int left, int top) const;
+
+	//Put each enemy in a slot for the battle's formation, small ones in small slots and large ones in large.
+	static void Layout(const Battle &battle, vector<BattleSprite> &sprites);
+
+private:
+
+	BattleAtlas atlas;
+	vector<BattleSprite> sprites;
+	unsigned int texture;
+	bool uploaded; //the texture has the current atlas
+};
+
+#endif
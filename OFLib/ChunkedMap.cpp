@@ -0,0 +1,173 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "ChunkedMap.h"
+#include <algorithm>
+
+ChunkedMap::ChunkedMap(string filename, int cacheSize)
+{
+	file.open(filename.c_str(), ios::in|ios::binary);
+
+	int header[4] = { 0, 0, 0, 1 };
+	file.read((char *)header, sizeof(header));
+	width = header[1];
+	height = header[2];
+	chunkSize = header[3];
+	chunksX = (width + chunkSize - 1)/chunkSize;
+	chunksY = (height + chunkSize - 1)/chunkSize;
+	dataStart = sizeof(header) + (chunksX*chunksY + 1)*sizeof(int);
+
+	//Everything the cache will ever need is allocated up front.
+	if (cacheSize < 1)
+		cacheSize = 1;
+	slots.resize(cacheSize);
+	for (int i = 0; i < cacheSize; i++)
+	{
+		slots[i].chunk = -1;
+		slots[i].lastUse = 0;
+		slots[i].tiles.resize(chunkSize*chunkSize);
+	}
+	chunkSlots.reserve(2*cacheSize);
+	useCounter = 0;
+	lastChunk = -1;
+	lastSlot = 0;
+}
+
+ChunkedMap::~ChunkedMap()
+{
+	file.close();
+}
+
+bool ChunkedMap::IsChunkedMap(string filename)
+{
+	ifstream mapFile(filename.c_str(), ios::in|ios::binary);
+	int magic = 0;
+	mapFile.read((char *)&magic, sizeof(int));
+	return magic == CHUNKED_MAP_MAGIC;
+}
+
+void ChunkedMap::Write(string filename, const int *tileIDs, int width, int height, int chunkSize)
+{
+	int chunksX = (width + chunkSize - 1)/chunkSize;
+	int chunksY = (height + chunkSize - 1)/chunkSize;
+
+	//Run-length encode each chunk.
+	vector<int> offsets, data;
+	for (int cy = 0; cy < chunksY; cy++)
+	{
+		for (int cx = 0; cx < chunksX; cx++)
+		{
+			offsets.push_back(data.size()*sizeof(int));
+			int runTile = -1, runLength = 0;
+			for (int y = cy*chunkSize; y < (cy + 1)*chunkSize; y++)
+			{
+				for (int x = cx*chunkSize; x < (cx + 1)*chunkSize; x++)
+				{
+					int tileID = (x < width && y < height) ? tileIDs[y*width + x] : 0;
+					if (tileID == runTile)
+					{
+						runLength++;
+						continue;
+					}
+					if (runLength > 0)
+					{
+						data.push_back(runLength);
+						data.push_back(runTile);
+					}
+					runTile = tileID;
+					runLength = 1;
+				}
+			}
+			data.push_back(runLength);
+			data.push_back(runTile);
+		}
+	}
+	offsets.push_back(data.size()*sizeof(int));
+
+	ofstream mapFile(filename.c_str(), ios::out|ios::binary);
+	int header[4] = { CHUNKED_MAP_MAGIC, width, height, chunkSize };
+	mapFile.write((char *)header, sizeof(header));
+	mapFile.write((char *)&offsets[0], offsets.size()*sizeof(int));
+	mapFile.write((char *)&data[0], data.size()*sizeof(int));
+	mapFile.close();
+}
+
+
+
+//Returns the slot holding a chunk, decoding it into the least recently used slot if needed.
+int ChunkedMap::FindChunk(int chunk)
+{
+	unordered_map<int, int>::iterator found = chunkSlots.find(chunk);
+	if (found != chunkSlots.end())
+	{
+		slots[found->second].lastUse = ++useCounter;
+		return found->second;
+	}
+
+	int oldest = 0;
+	for (int i = 1; i < (int)slots.size(); i++)
+		if (slots[i].lastUse < slots[oldest].lastUse)
+			oldest = i;
+
+	Slot &slot = slots[oldest];
+	if (slot.chunk >= 0)
+		chunkSlots.erase(slot.chunk);
+	DecodeChunk(chunk, slot.tiles);
+	slot.chunk = chunk;
+	slot.lastUse = ++useCounter;
+	chunkSlots[chunk] = oldest;
+	return oldest;
+}
+
+void ChunkedMap::DecodeChunk(int chunk, vector<int> &tiles)
+{
+	//Find the chunk's data from its table entry and the next one.
+	int offsets[2];
+	file.clear();
+	file.seekg(4*sizeof(int) + chunk*sizeof(int), ios::beg);
+	file.read((char *)offsets, sizeof(offsets));
+
+	//A chunk is never more than a run per tile, so anything bigger or backwards is a broken file.
+	int tile = 0, tileCount = chunkSize*chunkSize;
+	int runCount = 0;
+	if (file.gcount() == sizeof(offsets) && offsets[0] >= 0 && offsets[0] <= offsets[1] &&
+		(size_t)(offsets[1] - offsets[0]) <= 2*tileCount*sizeof(int))
+		runCount = (offsets[1] - offsets[0])/sizeof(int);
+	if (runCount > 0)
+	{
+		runs.resize(runCount);
+		file.seekg(dataStart + offsets[0], ios::beg);
+		file.read((char *)&runs[0], runCount*sizeof(int));
+		runCount = file.gcount()/sizeof(int);
+	}
+
+	for (int i = 0; i + 1 < runCount && tile < tileCount; i += 2)
+	{
+		int runEnd = tile + min(max(runs[i], 0), tileCount - tile);
+		int tileID = runs[i + 1];
+		while (tile < runEnd)
+			tiles[tile++] = tileID;
+	}
+
+	//Anything the runs don't cover is left as tile 0, the same as the ROM's own maps.
+	fill(tiles.begin() + tile, tiles.begin() + tileCount, 0);
+}
+
+void ChunkedMap::Focus(int col, int row, int radius)
+{
+	int centerX = col/chunkSize, centerY = row/chunkSize;
+	for (int cy = centerY - radius; cy <= centerY + radius; cy++)
+	{
+		for (int cx = centerX - radius; cx <= centerX + radius; cx++)
+		{
+			//The map wraps around, so the chunks across the edge count as nearby.
+			int x = (cx % chunksX + chunksX) % chunksX;
+			int y = (cy % chunksY + chunksY) % chunksY;
+			FindChunk(y*chunksX + x);
+		}
+	}
+	lastChunk = -1;
+}
@@ -0,0 +1,92 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* ChunkedMap.h
+* Defines a map of any size that is stored on disk in square chunks and only
+* decoded a few chunks at a time, around wherever the camera is.
+*****************************************************************************/
+
+#ifndef CHUNKEDMAP_H
+#define CHUNKEDMAP_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+using namespace std;
+
+#define CHUNKED_MAP_MAGIC 0x4D43464F //"OFCM"
+#define CHUNKED_MAP_CHUNK_SIZE 32 //tiles on a side
+#define CHUNKED_MAP_CACHE_SIZE 64 //chunks kept decoded
+
+/*
+A chunked map file consists of:
+int 0: CHUNKED_MAP_MAGIC
+int 1-3: Width and height in tiles, and the size of each chunk.
+The chunk table: one int per chunk giving where its data starts, relative
+	to the end of the table, plus one more for the end of the last chunk.
+	Chunks are listed a row at a time, from the top of the map down.
+The chunk data: pairs of ints (run length, tile ID) that cover every tile in
+	the chunk from its top row down.  Chunks on the right and bottom edges
+	are padded out to full size with tile 0.
+*/
+
+class ChunkedMap
+{
+public:
+
+	ChunkedMap(string filename, int cacheSize = CHUNKED_MAP_CACHE_SIZE);
+	~ChunkedMap();
+
+	//Write tiles (stored from the top row down, like a .map file) as a chunked map.
+	static void Write(string filename, const int *tileIDs, int width, int height, int chunkSize = CHUNKED_MAP_CHUNK_SIZE);
+
+	//Check whether a file is a chunked map, rather than a plain 64x64 .map.
+	static bool IsChunkedMap(string filename);
+
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	size_t GetByteSize() const { return slots.size()*chunkSize*chunkSize*sizeof(int); } //of the decoded chunks
+
+	//Look up a tile, with the row counted from the top of the map.
+	int GetTile(int col, int row)
+	{
+		int chunk = (row/chunkSize)*chunksX + col/chunkSize;
+		if (chunk != lastChunk)
+		{
+			lastSlot = FindChunk(chunk);
+			lastChunk = chunk;
+		}
+		return slots[lastSlot].tiles[(row%chunkSize)*chunkSize + col%chunkSize];
+	}
+
+	//Decode the chunks within radius chunks of a tile, so they're ready before the camera gets there.
+	void Focus(int col, int row, int radius = 1);
+
+private:
+
+	struct Slot
+	{
+		int chunk; //which chunk is decoded here, -1 if none
+		unsigned int lastUse;
+		vector<int> tiles;
+	};
+
+	int FindChunk(int chunk);
+	void DecodeChunk(int chunk, vector<int> &tiles);
+
+	ifstream file;
+	int width, height, chunkSize;
+	int chunksX, chunksY;
+	int dataStart; //the chunk table is read as needed rather than kept around
+
+	vector<Slot> slots;
+	unordered_map<int, int> chunkSlots; //which slot each decoded chunk is in
+	unsigned int useCounter;
+	int lastChunk, lastSlot; //most lookups land in the same chunk as the one before
+	vector<int> runs; //scratch space for decoding
+};
+
+#endif
@@ -71,4 +71,13 @@ enum Category
 	CAT_REGEN = 7
 };
 
+//Map tile properties.  The low byte holds these flags, and the high byte
+//is the index of the tile's teleport, treasure chest or battle.
+#define TILEPROP_SOLID 0x01 //can't walk onto this tile
+#define TILEPROP_SPECIAL_MASK 0x1E //doors, chests, damage tiles and the like
+#define TILEPROP_TELEPORT_MASK 0xC0
+#define TILEPROP_TELEPORT 0x40 //to another standard map
+#define TILEPROP_WARP 0x80 //back to the previous map
+#define TILEPROP_EXIT 0xC0 //out to the overworld
+
 #endif
\ No newline at end of file
@@ -13,6 +13,7 @@
 #define EXPRESSION_H
 #include "Script.h"
 #include <string>
+#include <sstream>
 using namespace std;
 
 //class ScriptManager;
@@ -27,6 +28,7 @@ protected:
 	static ScriptManager *scriptMan;
 
 public:
+	virtual ~Expression() {} //the operators delete their operands
 	virtual int Evaluate() = 0; //evaluate the expression and return the result
 	virtual string Serialize() = 0; //put the expression in the format described in Scripts.txt
 	virtual string ToString() = 0; //write the expression in prefix notation
@@ -126,7 +128,7 @@ public:
 
 	virtual int Evaluate() { return value; }
 	virtual string Serialize();
-	virtual string ToString() { char buff[12]; return itoa(value, buff, 10); }
+	virtual string ToString() { ostringstream oss; oss << value; return oss.str(); }
 };
 
 
@@ -0,0 +1,498 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "Fixtures.h"
+#include "ROM.h"
+#include "Tileset.h"
+#include "Platform.h"
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+using namespace std;
+
+#define SYNTHETIC_TILE_MAX 0x7E //0x7F with the run bit set would read as the $FF terminator
+#define SYNTHETIC_FLOOR_TILES 0x70 //map patterns below this are plain floor and walls, the rest lead somewhere
+#define SYNTHETIC_EXIT_PATTERN 0x78
+#define SYNTHETIC_WARP_PATTERN 0x7A
+#define SYNTHETIC_ENTRANCE_TILES 16 //overworld tiles from OVERWORLD_TILE_ENTRIES - 16 up are entrances
+#define SYNTHETIC_TILE_SIZE 16 //map tile images are 16x16
+
+//Where the synthetic names go: the free space after each pointer table.
+#define SYNTHETIC_MONSTER_TEXT_OFFSET (MONSTER_TEXT_PTR_TABLE_OFFSET + 2*MONSTER_ENTRIES)
+#define SYNTHETIC_MONSTER_TEXT_END WEAPON_OFFSET
+#define SYNTHETIC_ITEM_TEXT_OFFSET (ARMOR_TEXT_PTR_TABLE_OFFSET + 2*ARMOR_ENTRIES)
+#define SYNTHETIC_ITEM_TEXT_END BATTLE_OFFSET
+
+//The map pointer table, then the map RLE, fill the bank up to the battle tilesets.
+#define SYNTHETIC_MAP_DATA_OFFSET (MAP_OFFSET + 128)
+#define SYNTHETIC_MAP_DATA_END BATTLE_TILESET_OFFSET
+#define SYNTHETIC_OVERWORLD_DATA_OFFSET (OVERWORLD_OFFSET + 2*OVERWORLD_HEIGHT)
+#define SYNTHETIC_OVERWORLD_DATA_END (OVERWORLD_OFFSET + 0x4000)
+
+static void PutWord(vector<unsigned char> &rom, int offset, int value)
+{
+	rom[offset] = value & 0xFF;
+	rom[offset + 1] = (value >> 8) & 0xFF;
+}
+
+static void FillRandom(vector<unsigned char> &rom, CounterRNG &rng, int offset, int size, int lo, int hi)
+{
+	for (int i = 0; i < size; i++)
+		rom[offset + i] = (unsigned char)rng.Range(lo, hi);
+}
+
+//Runs of lo to hi tiles, averaging runLength tiles each.
+static void RandomRuns(CounterRNG &rng, int *tiles, int count, int runLength, int lo, int hi)
+{
+	int i = 0;
+	while (i < count)
+	{
+		int tile = rng.Range(lo, hi);
+		int length = rng.Range(1, 2*runLength - 1);
+		for (int j = 0; j < length && i < count; j++)
+			tiles[i++] = tile;
+	}
+}
+
+/*
+Encode tiles as the game's RLE (see ROM::DecodeMapRLE) onto the end of out,
+in no more than budget bytes.  If the runs would go over, the rest of the
+tiles become runs of whichever tile it got to, which always fit, since each
+step leaves room for them.
+*/
+static void EncodeRLE(const int *tiles, int count, int budget, vector<unsigned char> &out)
+{
+	int used = 0, i = 0;
+	while (i < count)
+	{
+		int length = 1;
+		while (i + length < count && length < 256 && tiles[i + length] == tiles[i])
+			length++;
+		int bytes = length == 1 ? 1 : 2;
+		int rest = count - i - length;
+
+		if (used + bytes + 2*((rest + 255)/256) + 1 > budget)
+		{
+			for (rest = count - i; rest > 0; rest -= 256)
+			{
+				out.push_back((unsigned char)(tiles[i] | 0x80));
+				out.push_back((unsigned char)(min(rest, 256) & 0xFF)); //0 means 256
+			}
+			break;
+		}
+
+		if (length == 1)
+			out.push_back((unsigned char)tiles[i]);
+		else
+		{
+			out.push_back((unsigned char)(tiles[i] | 0x80));
+			out.push_back((unsigned char)(length & 0xFF));
+		}
+		used += bytes;
+		i += length;
+	}
+	out.push_back(0xFF);
+}
+
+//A name that encodes to length letters: random ones, then the index so every name is different.
+static string SyntheticName(CounterRNG &rng, int index, int length)
+{
+	ostringstream digits;
+	digits << index;
+	string name;
+	int letters = length - (int)digits.str().size();
+	for (int i = 0; i < letters; i++)
+		name += (char)(i == 0 ? rng.Range('A', 'Z') : rng.Range('a', 'z'));
+	return (name + digits.str()).substr(0, length);
+}
+
+//Write names in the encoding of WriteSyntheticTables at offset, with their pointers relative to textBase.
+static int PutNames(vector<unsigned char> &rom, CounterRNG &rng, int pointerTable, int textBase, int offset, int count, int length)
+{
+	for (int i = 0; i < count; i++)
+	{
+		PutWord(rom, pointerTable + 2*i, offset - textBase);
+		string name = SyntheticName(rng, i, length);
+		for (int j = 0; j < (int)name.size(); j++)
+		{
+			char c = name[j];
+			if (c >= '0' && c <= '9')
+				rom[offset++] = 0x80 + (c - '0');
+			else if (c >= 'A' && c <= 'Z')
+				rom[offset++] = 0x8A + (c - 'A');
+			else
+				rom[offset++] = 0xA4 + (c - 'a');
+		}
+		rom[offset++] = 0;
+	}
+	return offset;
+}
+
+//The standard table's letters are where the real game keeps them; the DTE table is just letter pairs.
+static bool WriteSyntheticTables(string directory, CounterRNG &rng)
+{
+	ofstream standard((directory + "/" + STANDARD_TABLE_FILE).c_str());
+	for (int i = 0; i < 10; i++)
+		standard << hex << uppercase << setw(2) << setfill('0') << 0x80 + i << '=' << (char)('0' + i) << endl;
+	for (int i = 0; i < 26; i++)
+		standard << hex << uppercase << setw(2) << setfill('0') << 0x8A + i << '=' << (char)('A' + i) << endl;
+	for (int i = 0; i < 26; i++)
+		standard << hex << uppercase << setw(2) << setfill('0') << 0xA4 + i << '=' << (char)('a' + i) << endl;
+	standard << "FF= " << endl;
+
+	ofstream dte((directory + "/" + DTE_TABLE_FILE).c_str());
+	for (int i = 0x1A; i < 0x6A; i++)
+		dte << hex << uppercase << setw(2) << setfill('0') << i << '=' << (char)rng.Range('a', 'z') << (char)rng.Range('a', 'z') << endl;
+
+	//A smooth spread of colors, BGR like FFHackster.pal.
+	ofstream palette((directory + "/" + NES_PALETTE_FILE).c_str(), ios::out|ios::binary);
+	for (int i = 0; i < NES_PALETTE_ENTRIES; i++)
+	{
+		unsigned char color[3] = { (unsigned char)(64*(i % 4)), (unsigned char)(64*((i/4) % 4)), (unsigned char)(64*(i/16)) };
+		palette.write((char *)color, 3);
+	}
+
+	return standard.good() && dte.good() && palette.good();
+}
+
+/****************************************************
+* SYNTHETIC ROM
+*****************************************************
+Everything is written where the ROM class reads it, and only in ranges it
+copes with: tile IDs that index real patterns, teleports that lead to real
+maps, battle palettes and tilesets that exist.  Each table gets its own
+stream of the seed, so changing one option doesn't reshuffle the rest.
+*/
+bool WriteSyntheticROM(string directory, string filename, SyntheticROMOptions &options)
+{
+	int monsterTextMax = (SYNTHETIC_MONSTER_TEXT_END - SYNTHETIC_MONSTER_TEXT_OFFSET)/MONSTER_ENTRIES - 1;
+	int itemTextMax = (SYNTHETIC_ITEM_TEXT_END - SYNTHETIC_ITEM_TEXT_OFFSET)/(WEAPON_ENTRIES + ARMOR_ENTRIES) - 1;
+	options.nameLength = max(1, min(options.nameLength, min(monsterTextMax, itemTextMax)));
+	options.runLength = max(1, min(options.runLength, 256));
+
+	CounterRNG seed(options.seed);
+	vector<unsigned char> rom(SYNTHETIC_ROM_SIZE, 0);
+
+	//iNES header: 16 PRG banks, CHR RAM, mapper 1 with battery backed save RAM.
+	rom[0] = 'N'; rom[1] = 'E'; rom[2] = 'S'; rom[3] = 0x1A;
+	rom[4] = 16; rom[5] = 0; rom[6] = 0x12;
+
+	//Names and the tables that go with them.
+	CounterRNG rng = seed.Stream(1);
+	PutNames(rom, rng, MONSTER_TEXT_PTR_TABLE_OFFSET, MONSTER_TEXT_BASE, SYNTHETIC_MONSTER_TEXT_OFFSET, MONSTER_ENTRIES, options.nameLength);
+	int itemText = PutNames(rom, rng, WEAPON_TEXT_PTR_TABLE_OFFSET, WEAPON_TEXT_BASE, SYNTHETIC_ITEM_TEXT_OFFSET, WEAPON_ENTRIES, options.nameLength);
+	PutNames(rom, rng, ARMOR_TEXT_PTR_TABLE_OFFSET, ARMOR_TEXT_BASE, itemText, ARMOR_ENTRIES, options.nameLength);
+
+	rng = seed.Stream(2);
+	FillRandom(rom, rng, MONSTER_OFFSET, MONSTER_ENTRIES*MONSTER_SIZE, 0, 255);
+	for (int i = 0; i < MONSTER_ENTRIES; i++)
+		rom[MONSTER_OFFSET + i*MONSTER_SIZE + 7] = rng.Percent(50) ? AI_NONE : rng.Range(0, AI_ENTRIES - 1);
+	for (int i = 0; i < AI_ENTRIES; i++)
+	{
+		int offset = AI_OFFSET + i*AI_SIZE;
+		rom[offset] = rng.Range(0, 128);
+		rom[offset + 1] = rng.Range(0, 128);
+		for (int j = 0; j < 8; j++)
+			rom[offset + 2 + j] = rng.Percent(25) ? 0xFF : rng.Range(0, SPELL_ENTRIES - 1);
+		for (int j = 0; j < 4; j++)
+			rom[offset + 11 + j] = rng.Percent(25) ? 0xFF : rng.Range(0, ABIL_ENTRIES - 1);
+	}
+
+	rng = seed.Stream(3);
+	FillRandom(rom, rng, WEAPON_OFFSET, WEAPON_ENTRIES*WEAPON_SIZE, 0, 255);
+	FillRandom(rom, rng, WEAPON_PRICE_OFFSET, 2*WEAPON_ENTRIES, 0, 255);
+	FillRandom(rom, rng, WEAPON_PERMS_OFFSET, 2*WEAPON_ENTRIES, 0, 255);
+	FillRandom(rom, rng, ARMOR_OFFSET, ARMOR_ENTRIES*ARMOR_SIZE, 0, 255);
+	FillRandom(rom, rng, ARMOR_PRICE_OFFSET, 2*ARMOR_ENTRIES, 0, 255);
+	FillRandom(rom, rng, ARMOR_PERMS_OFFSET, 2*ARMOR_ENTRIES, 0, 255);
+	FillRandom(rom, rng, SPELL_OFFSET, SPELL_ENTRIES*SPELL_SIZE, 0, 255);
+	FillRandom(rom, rng, SPELL_PRICE_OFFSET, 2*SPELL_ENTRIES, 0, 255);
+	FillRandom(rom, rng, SPELL_PERMS_OFFSET, SPELL_PERMS_ENTRIES*SPELL_PERMS_SIZE, 0, 255);
+	FillRandom(rom, rng, ABIL_OFFSET, ABIL_ENTRIES*ABIL_SIZE, 0, 255);
+
+	//Battles, with the fiends and Chaos where the boss graphics expect them.
+	rng = seed.Stream(4);
+	for (int i = 0; i < BATTLE_ENTRIES; i++)
+	{
+		int offset = BATTLE_OFFSET + i*BATTLE_SIZE;
+		bool boss = i >= FIEND_BATTLE;
+		int formation = i == CHAOS_BATTLE ? 5 : (boss ? 4 : rng.Range(1, 3));
+		rom[offset] = (formation << 4) | rng.Range(0, BATTLE_TILESET_ENTRIES - 1);
+		rom[offset + 1] = rng.Range(0, 255);
+		for (int j = 0; j < 4; j++)
+			rom[offset + 2 + j] = boss ? MONSTER_ENTRIES - 9 + (i - FIEND_BATTLE) % 9 : rng.Range(0, MONSTER_ENTRIES - 10);
+		for (int j = 0; j < 4; j++)
+			rom[offset + 6 + j] = (rng.Range(0, 2) << 4) | rng.Range(2, 9);
+		rom[offset + 10] = rng.Range(0, BATTLE_PALETTE_ENTRIES - 1);
+		rom[offset + 11] = rng.Range(0, BATTLE_PALETTE_ENTRIES - 1);
+		rom[offset + 12] = rng.Range(0, 100);
+		rom[offset + 13] = rng.Range(0, 255);
+		rom[offset + 14] = rom[offset + 15] = 0;
+	}
+	FillRandom(rom, rng, BATTLE_PALETTE_OFFSET, BATTLE_PALETTE_ENTRIES*BATTLE_PALETTE_SIZE, 0, NES_PALETTE_ENTRIES - 1);
+	FillRandom(rom, rng, BATTLE_TILESET_OFFSET, BATTLE_TILESET_ENTRIES*BATTLE_TILESET_TILE_ENTRIES*BATTLE_TILE_SIZE, 0, 255);
+	FillRandom(rom, rng, FIEND_PATTERN_TABLE, CHAOS_PATTERN - FIEND_PATTERN_TABLE, 0, BATTLE_TILESET_TILE_ENTRIES - 1);
+	FillRandom(rom, rng, CHAOS_PATTERN, CHAOS_OVERLAY - CHAOS_PATTERN, 0, BATTLE_TILESET_TILE_ENTRIES - 1);
+	FillRandom(rom, rng, CHAOS_OVERLAY, MONSTER_TEXT_PTR_TABLE_OFFSET - CHAOS_OVERLAY, 0, 255);
+
+	//Map tilesets: the first patterns are floor and walls, then a few of each kind of teleport.
+	rng = seed.Stream(5);
+	FillRandom(rom, rng, MAP_TILESET_OFFSET, MAP_TILESET_ENTRIES*MAP_TILESET_TILE_ENTRIES*MAP_TILE_SIZE, 0, 255);
+	FillRandom(rom, rng, MAP_TILESET_PATTERN_OFFSET, MAP_TILESET_ENTRIES*MAP_TILESET_PATTERN_ENTRIES*MAP_TILESET_PATTERN_SIZE, 0, MAP_TILESET_TILE_ENTRIES - 1);
+	FillRandom(rom, rng, MAP_TILESET_PALETTE_ASSIGNMENT_OFFSET, MAP_TILESET_ENTRIES*MAP_TILESET_PATTERN_ENTRIES, 0, 3);
+	for (int tileset = 0; tileset < MAP_TILESET_ENTRIES; tileset++)
+	{
+		for (int i = 0; i < MAP_TILESET_PATTERN_ENTRIES; i++)
+		{
+			int offset = MAP_TILESET_PROPERTY_OFFSET + (tileset*MAP_TILESET_PATTERN_ENTRIES + i)*MAP_TILESET_PROPERTY_SIZE;
+			if (i < SYNTHETIC_FLOOR_TILES || i > SYNTHETIC_WARP_PATTERN)
+			{
+				rom[offset] = rng.Percent(25) ? TILEPROP_SOLID : 0;
+				rom[offset + 1] = 0;
+			}
+			else if (i < SYNTHETIC_EXIT_PATTERN)
+			{
+				rom[offset] = TILEPROP_TELEPORT;
+				rom[offset + 1] = rng.Range(0, NORM_TELE_ENTRIES - 1);
+			}
+			else if (i < SYNTHETIC_WARP_PATTERN)
+			{
+				rom[offset] = TILEPROP_EXIT;
+				rom[offset + 1] = rng.Range(0, EXIT_TELE_ENTRIES - 1);
+			}
+			else
+				rom[offset] = TILEPROP_WARP;
+		}
+	}
+
+	//Two palette sets per tileset keep the unique tileset/palette pairs under the exporter's TILESET_NAMES.
+	for (int mapIndex = 0; mapIndex < MAP_ENTRIES; mapIndex++)
+	{
+		int tileset = mapIndex % MAP_TILESET_ENTRIES;
+		rom[MAP_TILESET_ASSIGNMENT_OFFSET + mapIndex] = tileset;
+		CounterRNG colors = seed.Stream(16 + 2*tileset + (mapIndex/MAP_TILESET_ENTRIES) % 2);
+		FillRandom(rom, colors, MAP_PALETTE_OFFSET + MAP_PALETTES_PER_MAP*mapIndex*MAP_PALETTE_SIZE, MAP_PALETTES_PER_MAP*MAP_PALETTE_SIZE, 0, NES_PALETTE_ENTRIES - 1);
+	}
+
+	//Teleport tables.
+	rng = seed.Stream(6);
+	for (int i = 0; i < NORM_TELE_ENTRIES; i++)
+	{
+		rom[NORM_TELE_OFFSET + i] = rng.Range(0, MAP_WIDTH - 1) | (rng.Percent(25) ? TELE_IN_ROOM : 0);
+		rom[NORM_TELE_OFFSET + NORM_TELE_ENTRIES + i] = rng.Range(0, MAP_HEIGHT - 1);
+		rom[NORM_TELE_OFFSET + 2*NORM_TELE_ENTRIES + i] = rng.Range(0, MAP_ENTRIES - 1);
+	}
+	for (int i = 0; i < ENTR_TELE_ENTRIES; i++)
+	{
+		rom[ENTR_TELE_OFFSET + i] = rng.Range(0, MAP_WIDTH - 1);
+		rom[ENTR_TELE_OFFSET + ENTR_TELE_ENTRIES + i] = rng.Range(0, MAP_HEIGHT - 1);
+		rom[ENTR_TELE_OFFSET + 2*ENTR_TELE_ENTRIES + i] = rng.Range(0, MAP_ENTRIES - 1);
+	}
+	FillRandom(rom, rng, EXIT_TELE_OFFSET, 2*EXIT_TELE_ENTRIES, 0, OVERWORLD_WIDTH - 1);
+
+	//The maps, each given an even share of what's left of the bank.
+	rng = seed.Stream(7);
+	vector<unsigned char> stream;
+	vector<int> tiles(MAP_WIDTH*MAP_HEIGHT);
+	for (int mapIndex = 0; mapIndex < MAP_ENTRIES; mapIndex++)
+	{
+		RandomRuns(rng, &tiles[0], tiles.size(), options.runLength, 0, SYNTHETIC_FLOOR_TILES - 1);
+		for (int i = 0; i < SYNTHETIC_EXITS_PER_MAP; i++)
+			tiles[rng.Range(0, tiles.size() - 1)] = rng.Range(SYNTHETIC_FLOOR_TILES, SYNTHETIC_WARP_PATTERN);
+
+		int start = SYNTHETIC_MAP_DATA_OFFSET + stream.size();
+		PutWord(rom, MAP_OFFSET + 2*mapIndex, start - MAP_OFFSET);
+		EncodeRLE(&tiles[0], tiles.size(), (SYNTHETIC_MAP_DATA_END - start)/(MAP_ENTRIES - mapIndex), stream);
+	}
+	copy(stream.begin(), stream.end(), rom.begin() + SYNTHETIC_MAP_DATA_OFFSET);
+
+	//The overworld, a row at a time, with a few entrances.
+	rng = seed.Stream(8);
+	for (int i = 0; i < OVERWORLD_TILE_ENTRIES; i++)
+	{
+		int offset = OVERWORLD_TILE_PROPERTY_OFFSET + i*MAP_TILESET_PROPERTY_SIZE;
+		bool entrance = i >= OVERWORLD_TILE_ENTRIES - SYNTHETIC_ENTRANCE_TILES;
+		rom[offset] = entrance ? 0 : (rng.Percent(25) ? TILEPROP_SOLID : 0);
+		rom[offset + 1] = entrance ? OVERWORLD_PROP_ENTRANCE | (i % ENTR_TELE_ENTRIES) : 0;
+	}
+	stream.clear();
+	tiles.resize(OVERWORLD_WIDTH);
+	for (int row = 0; row < OVERWORLD_HEIGHT; row++)
+	{
+		RandomRuns(rng, &tiles[0], tiles.size(), options.runLength, 0, OVERWORLD_TILE_ENTRIES - SYNTHETIC_ENTRANCE_TILES - 1);
+		if (rng.Percent(10))
+			tiles[rng.Range(0, OVERWORLD_WIDTH - 1)] = rng.Range(OVERWORLD_TILE_ENTRIES - SYNTHETIC_ENTRANCE_TILES, SYNTHETIC_TILE_MAX);
+
+		int start = SYNTHETIC_OVERWORLD_DATA_OFFSET + stream.size();
+		PutWord(rom, OVERWORLD_OFFSET + 2*row, start - OVERWORLD_OFFSET + OVERWORLD_BANK_BASE);
+		EncodeRLE(&tiles[0], tiles.size(), (SYNTHETIC_OVERWORLD_DATA_END - start)/(OVERWORLD_HEIGHT - row), stream);
+	}
+	copy(stream.begin(), stream.end(), rom.begin() + SYNTHETIC_OVERWORLD_DATA_OFFSET);
+
+	//The RNG table is a shuffle of every byte, as in the game.
+	rng = seed.Stream(9);
+	for (int i = 0; i < RNG_TABLE_SIZE; i++)
+		rom[RNG_TABLE_OFFSET + i] = i;
+	for (int i = RNG_TABLE_SIZE - 1; i > 0; i--)
+		swap(rom[RNG_TABLE_OFFSET + i], rom[RNG_TABLE_OFFSET + rng.Range(0, i)]);
+
+	_mkdir(directory.c_str());
+	ofstream romFile((directory + "/" + filename).c_str(), ios::out|ios::binary);
+	romFile.write((char *)&rom[0], rom.size());
+
+	rng = seed.Stream(10);
+	return WriteSyntheticTables(directory, rng) && romFile.good();
+}
+
+
+
+/****************************************************
+* SYNTHETIC QUEST
+*****************************************************
+A quest isn't bound by the ROM's sizes, so this is the one to scale up: more
+maps, bigger maps (written chunked), more and bigger tilesets.
+*/
+
+//Make each directory along path.
+static void MakeDirectories(string path)
+{
+	for (size_t slash = path.find('/', 1); slash != string::npos; slash = path.find('/', slash + 1))
+		_mkdir(path.substr(0, slash).c_str());
+	_mkdir(path.c_str());
+}
+
+static string SyntheticMapName(int mapIndex)
+{
+	if (mapIndex == 0)
+		return SYNTHETIC_START_MAP;
+	ostringstream oss;
+	oss << "Synthetic Map " << mapIndex;
+	return oss.str();
+}
+
+//Tiles are blocks of 4x4 pixels, in colors from 0 to colorCount - 1.
+static void RandomTilePixels(CounterRNG &rng, unsigned char *pixels, int colorCount)
+{
+	for (int block = 0; block < 16; block++)
+	{
+		int color = rng.Range(0, colorCount - 1);
+		for (int y = 0; y < 4; y++)
+			for (int x = 0; x < 4; x++)
+				pixels[SYNTHETIC_TILE_SIZE*(4*(block/4) + y) + 4*(block % 4) + x] = color;
+	}
+}
+
+//One tileset directory, indexed or RGB, laid out as the exporter writes them.
+static bool WriteSyntheticTileset(string path, string name, CounterRNG &rng, int tileCount, const unsigned char (*colors)[3])
+{
+	string fullpath = path + "/" + name;
+	_mkdir(fullpath.c_str());
+	ofstream tilesetFile((fullpath + "/" + name + ".txt").c_str());
+	tilesetFile << "TileID\tFilename\tProperties" << endl;
+
+	unsigned char pixels[SYNTHETIC_TILE_SIZE*SYNTHETIC_TILE_SIZE];
+	unsigned char rgb[3*SYNTHETIC_TILE_SIZE*SYNTHETIC_TILE_SIZE];
+	for (int i = 0; i < tileCount; i++)
+	{
+		ostringstream oss;
+		oss << "tile" << setw(3) << setfill('0') << i << ".bmp";
+		RandomTilePixels(rng, pixels, PALETTE_COLORS);
+		if (colors)
+			ROM::WriteIndexedBMPImage(pixels, SYNTHETIC_TILE_SIZE, SYNTHETIC_TILE_SIZE, colors, PALETTE_COLORS, fullpath + "/" + oss.str());
+		else
+		{
+			for (int j = 0; j < SYNTHETIC_TILE_SIZE*SYNTHETIC_TILE_SIZE; j++)
+				for (int k = 0; k < 3; k++)
+					rgb[3*j + k] = (unsigned char)(pixels[j]*(k + 5));
+			ROM::WriteBMPImage(rgb, SYNTHETIC_TILE_SIZE, SYNTHETIC_TILE_SIZE, fullpath + "/" + oss.str());
+		}
+		tilesetFile << i << '\t' << oss.str() << '\t' << (rng.Percent(25) ? TILEPROP_SOLID : 0) << endl;
+	}
+	return tilesetFile.good();
+}
+
+bool WriteSyntheticQuest(string root, SyntheticQuestOptions &options)
+{
+	options.maps = max(1, options.maps);
+	options.mapWidth = max(1, options.mapWidth);
+	options.mapHeight = max(1, options.mapHeight);
+	options.tilesets = max(1, options.tilesets);
+	options.tilesPerTileset = max(1, options.tilesPerTileset);
+	options.runLength = max(1, options.runLength);
+	options.exitsPerMap = max(0, min(options.exitsPerMap, options.maps - 1));
+
+	CounterRNG seed(options.seed);
+	string graphics = root + "/Graphics/Maps";
+	MakeDirectories(root + "/Maps");
+	MakeDirectories(graphics + "/Palettes");
+	bool written = true;
+
+	CounterRNG rng = seed.Stream(1);
+	unsigned char colors[PALETTE_COLORS][3];
+	for (int tileset = 0; tileset < options.tilesets; tileset++)
+	{
+		for (int i = 0; i < PALETTE_COLORS; i++)
+			for (int k = 0; k < 3; k++)
+				colors[i][k] = rng.Range(0, 255);
+		written &= WriteSyntheticTileset(graphics, IndexedTilesetName(tileset), rng, options.tilesPerTileset, colors);
+	}
+	written &= WriteSyntheticTileset(graphics, "Castle", rng, options.tilesPerTileset, NULL);
+	written &= WriteSyntheticTileset(graphics, "Castle (Rooms)", rng, options.tilesPerTileset, NULL);
+
+	rng = seed.Stream(2);
+	vector<int> tiles(options.mapWidth*options.mapHeight);
+	for (int mapIndex = 0; mapIndex < options.maps; mapIndex++)
+	{
+		string name = SyntheticMapName(mapIndex);
+		RandomRuns(rng, &tiles[0], tiles.size(), options.runLength, 0, options.tilesPerTileset - 1);
+		string filename = root + "/Maps/" + name + ".map";
+		if (options.mapWidth == MAP_WIDTH && options.mapHeight == MAP_HEIGHT)
+		{
+			ofstream mapFile(filename.c_str(), ios::out|ios::binary);
+			mapFile.write((char *)&tiles[0], tiles.size()*sizeof(int));
+			written &= mapFile.good();
+		}
+		else
+			ChunkedMap::Write(filename, &tiles[0], options.mapWidth, options.mapHeight);
+
+		//Same layout as ROM::DumpIndexedMapGraphics.
+		ofstream paletteFile((graphics + "/Palettes/" + name + ".pal").c_str(), ios::out|ios::binary);
+		int tileset = mapIndex % options.tilesets;
+		paletteFile.write((char *)&tileset, sizeof(int));
+		for (int i = 0; i < PALETTE_ROWS*PALETTE_COLORS*3; i++)
+			paletteFile.put((char)rng.Range(0, 255));
+		written &= paletteFile.good();
+	}
+
+	//Each map leads on to the next few, so the engine can be walked through all of them.
+	rng = seed.Stream(3);
+	ofstream exitsFile((root + "/Exits.txt").c_str());
+	exitsFile << "Map\tX\tY\tType\tDestination\tDestX\tDestY\tInRoom" << endl;
+	for (int mapIndex = 0; mapIndex < options.maps; mapIndex++)
+	{
+		for (int i = 0; i < options.exitsPerMap; i++)
+		{
+			exitsFile << SyntheticMapName(mapIndex) << ".map\t";
+			exitsFile << rng.Range(0, options.mapWidth - 1) << '\t';
+			exitsFile << rng.Range(0, options.mapHeight - 1) << '\t';
+			exitsFile << MapExits::TypeName(EXIT_TELEPORT) << '\t';
+			exitsFile << SyntheticMapName((mapIndex + i + 1) % options.maps) << ".map\t";
+			exitsFile << rng.Range(0, options.mapWidth - 1) << '\t';
+			exitsFile << rng.Range(0, options.mapHeight - 1) << '\t';
+			exitsFile << (rng.Percent(25) ? 1 : 0) << endl;
+		}
+	}
+	written &= exitsFile.good();
+
+	//Without palette shaders the engine draws every map with the RGB castle tilesets.
+	ofstream manifest((graphics + "/" + MAP_TILESET_MANIFEST).c_str());
+	manifest << "Map\tTileset\tRoomTileset" << endl;
+	for (int mapIndex = 0; mapIndex < options.maps; mapIndex++)
+		manifest << SyntheticMapName(mapIndex) << ".map\tCastle\tCastle (Rooms)" << endl;
+	written &= manifest.good();
+
+	return written;
+}
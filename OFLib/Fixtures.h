@@ -0,0 +1,65 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* Fixtures.h
+* Defines generators for made-up ROMs and quests, filled with random but
+* valid data, for timing the exporter and the engine without the real game.
+*****************************************************************************/
+
+#ifndef FIXTURES_H
+#define FIXTURES_H
+
+#include <string>
+using namespace std;
+
+const string SYNTHETIC_ROM_FILENAME = "synthetic.nes";
+const string SYNTHETIC_START_MAP = "Elfland Castle"; //the engine starts here, so the first map is named for it
+
+#define SYNTHETIC_ROM_SIZE 0x40010 //a 16 byte iNES header, then 16 banks of 16 kB
+#define SYNTHETIC_RUN_LENGTH 16 //average tiles in an RLE run
+#define SYNTHETIC_NAME_LENGTH 8
+#define SYNTHETIC_EXITS_PER_MAP 4
+
+/* The ROM's layout is fixed: there are always MAP_ENTRIES 64x64 maps and a
+   256x256 overworld, in banks of a fixed size.  What can change is how hard
+   they are to decode.  Shorter runs mean longer RLE streams, down to what
+   still fits in the banks; longer names mean more text to decode. */
+struct SyntheticROMOptions
+{
+	SyntheticROMOptions() : seed(1), runLength(SYNTHETIC_RUN_LENGTH), nameLength(SYNTHETIC_NAME_LENGTH) {}
+
+	unsigned long long seed;
+	int runLength;
+	int nameLength;
+};
+
+//A quest has no such limits, so its maps can be any size and number.
+struct SyntheticQuestOptions
+{
+	SyntheticQuestOptions() : seed(1), maps(61), mapWidth(64), mapHeight(64), tilesets(8), tilesPerTileset(128),
+		runLength(SYNTHETIC_RUN_LENGTH), exitsPerMap(SYNTHETIC_EXITS_PER_MAP) {}
+
+	unsigned long long seed;
+	int maps;
+	int mapWidth, mapHeight; //64x64 maps are written as plain .map files, others as chunked maps
+	int tilesets; //indexed tilesets, shared out between the maps
+	int tilesPerTileset;
+	int runLength;
+	int exitsPerMap; //teleports to the next few maps
+};
+
+/* Write filename to directory, along with the text tables and NES palette
+   the ROM class reads.  Every table ROM.h knows about is filled in, the
+   same seed always gives the same ROM, and options are clamped to what
+   fits; the clamped values are written back.  Returns false if the files
+   couldn't be written. */
+bool WriteSyntheticROM(string directory, string filename, SyntheticROMOptions &options);
+
+/* Write a quest laid out like the exporter's output under root: the maps,
+   their palettes, the indexed tilesets, the "Castle" tilesets and a map
+   tileset manifest pointing every map at them, and Exits.txt. */
+bool WriteSyntheticQuest(string root, SyntheticQuestOptions &options);
+
+#endif
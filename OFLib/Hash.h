@@ -0,0 +1,92 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* Hash.h
+* Defines a quick 64-bit hash for recognizing identical data.
+*****************************************************************************/
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <sys/stat.h>
+using namespace std;
+
+#define FNV_OFFSET_BASIS 0xCBF29CE484222325ULL
+#define FNV_PRIME 0x100000001B3ULL
+
+//FNV-1a.  Pass the result of one call as the start of the next to hash several pieces as one.
+inline unsigned long long HashBytes(const void *data, size_t size, unsigned long long hash = FNV_OFFSET_BASIS)
+{
+	const unsigned char *bytes = (const unsigned char *)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+//Hash a whole file.  A missing file hashes the same as an empty one.
+inline unsigned long long HashFile(string filename, unsigned long long hash = FNV_OFFSET_BASIS)
+{
+	ifstream file(filename.c_str(), ios::in|ios::binary);
+	char buffer[4096];
+	while (file)
+	{
+		file.read(buffer, sizeof(buffer));
+		hash = HashBytes(buffer, (size_t)file.gcount(), hash);
+	}
+	return hash;
+}
+
+//Hash when a file was last changed and how big it is, without reading it.
+inline unsigned long long HashFileStamp(string filename, unsigned long long hash = FNV_OFFSET_BASIS)
+{
+	long long stamp[2] = { -1, -1 }; //missing
+	struct stat info;
+	if (stat(filename.c_str(), &info) == 0)
+	{
+		stamp[0] = info.st_mtime;
+		stamp[1] = info.st_size;
+	}
+	return HashBytes(stamp, sizeof(stamp), hash);
+}
+
+//The files something was loaded from, so a change to them on disk can be spotted later.
+struct FileSource
+{
+	vector<string> files;
+	unsigned long long hash; //of their contents
+	unsigned long long stamp; //of their sizes and modification times, which is much quicker to check
+};
+
+inline unsigned long long HashFiles(const vector<string> &files)
+{
+	unsigned long long hash = FNV_OFFSET_BASIS;
+	for (int i = 0; i < (int)files.size(); i++)
+		hash = HashFile(files[i], hash);
+	return hash;
+}
+
+inline unsigned long long StampFiles(const vector<string> &files)
+{
+	unsigned long long stamp = FNV_OFFSET_BASIS;
+	for (int i = 0; i < (int)files.size(); i++)
+		stamp = HashFileStamp(files[i], stamp);
+	return stamp;
+}
+
+//Stamped first, so a change while it's hashed is noticed next time.
+inline void ReadFileSource(FileSource &source)
+{
+	source.stamp = StampFiles(source.files);
+	source.hash = HashFiles(source.files);
+}
+
+#endif
@@ -0,0 +1,536 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "Loadout.h"
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <climits>
+using namespace std;
+
+//The options for one job in the party, shared by every member with that job.
+struct LoadoutOptimizer::JobLists
+{
+	Job job;
+	Option slots[NUM_SLOTS][LOADOUT_MAX_ITEMS + 1];
+	int sizes[NUM_SLOTS];
+	vector<ArmorSet> armorSets; //best first
+};
+
+//State for the branch and bound search over the whole party.
+struct LoadoutOptimizer::SearchState
+{
+	JobLists jobs[LOADOUT_MAX_PARTY];
+	const JobLists *lists[LOADOUT_MAX_PARTY];
+	int order[LOADOUT_MAX_PARTY]; //party members in the order they're searched, with the same jobs together
+	int partySize;
+
+	Option pool[NUM_SLOTS][LOADOUT_MAX_ITEMS]; //every item anyone might use in a slot, best first
+	int poolSizes[NUM_SLOTS];
+
+	int weaponsLeft[LOADOUT_MAX_ITEMS], armorLeft[LOADOUT_MAX_ITEMS];
+	int weaponChoice[LOADOUT_MAX_PARTY], armorChoice[LOADOUT_MAX_PARTY]; //positions in the member's lists
+	int bestWeapon[LOADOUT_MAX_PARTY], bestArmor[LOADOUT_MAX_PARTY];
+	int bestWeaponScore, bestArmorScore;
+};
+
+static int WeaponScore(int power, int accuracy, int critical, const LoadoutObjective &objective)
+{
+	return power*objective.power + accuracy*objective.accuracy + critical*objective.critical;
+}
+
+static int ArmorScore(int defense, int weight, const LoadoutObjective &objective)
+{
+	return defense*objective.defense - weight*objective.weight;
+}
+
+//What the best protection worn from each element is worth, counting only the elements wanted if asked.
+static int ElementScore(const int *protection, const LoadoutObjective &objective, bool wantedOnly)
+{
+	int score = 0;
+	for (int i = 0; i < NUM_ELEMS; i++)
+		if (!wantedOnly || objective.elements[i] > 0)
+			score += protection[i]*objective.elements[i];
+	return score;
+}
+
+LoadoutOptimizer::LoadoutOptimizer(const vector<Weapon> &weapons, const vector<Armor> &armor)
+{
+	for (int i = 0; i < NUM_SLOTS; i++)
+		for (int j = 0; j < NUM_JOBS; j++)
+			jobMasks[i][j] = 0;
+
+	//Weapons all go in the weapon slot.
+	weaponCount = min((int)weapons.size(), LOADOUT_MAX_ITEMS);
+	for (int i = 0; i < weaponCount; i++)
+	{
+		ItemStats &stats = weaponStats[i];
+		stats.power = weapons[i].power;
+		stats.accuracy = weapons[i].accuracy;
+		stats.critical = weapons[i].critical;
+		stats.defense = stats.weight = 0;
+		for (int j = 0; j < NUM_ELEMS; j++)
+			stats.elemMod[j] = 0;
+
+		for (int j = 0; j < NUM_JOBS; j++)
+			if (weapons[i].equipMask & (1<<j))
+				jobMasks[SLOT_WEAPON][j] |= (1ULL<<i);
+	}
+
+	//Armor is sorted into slots by where it is worn.
+	armorCount = min((int)armor.size(), LOADOUT_MAX_ITEMS);
+	for (int i = 0; i < armorCount; i++)
+	{
+		ItemStats &stats = armorStats[i];
+		stats.power = stats.accuracy = stats.critical = 0;
+		stats.defense = armor[i].defense;
+		stats.weight = armor[i].weight;
+		for (int j = 0; j < NUM_ELEMS; j++)
+			stats.elemMod[j] = max(armor[i].elemMod[j], 0); //armor only ever protects
+
+		int slot;
+		if (armor[i].wearloc & (1<<WEAR_BODY))
+			slot = SLOT_BODY;
+		else if (armor[i].wearloc & (1<<WEAR_OFFHAND))
+			slot = SLOT_SHIELD;
+		else if (armor[i].wearloc & (1<<WEAR_HEAD))
+			slot = SLOT_HELM;
+		else if (armor[i].wearloc & (1<<WEAR_GLOVE))
+			slot = SLOT_GLOVE;
+		else
+			continue; //relics aren't searched
+
+		for (int j = 0; j < NUM_JOBS; j++)
+			if (armor[i].equipMask & (1<<j))
+				jobMasks[slot][j] |= (1ULL<<i);
+	}
+}
+
+
+
+//What an item adds to a loadout at most.  Protection only counts for as much as the armor already worn doesn't give.
+int LoadoutOptimizer::OptimisticScore(int slot, int item, const LoadoutObjective &objective) const
+{
+	if (slot == SLOT_WEAPON)
+		return WeaponScore(weaponStats[item].power, weaponStats[item].accuracy, weaponStats[item].critical, objective);
+
+	const ItemStats &stats = armorStats[item];
+	return ArmorScore(stats.defense, stats.weight, objective) + ElementScore(stats.elemMod, objective, true);
+}
+
+//Returns true if item a is never worse than item b in the given slot.
+bool LoadoutOptimizer::Dominates(int slot, int a, int b, const LoadoutObjective &objective) const
+{
+	if (slot == SLOT_WEAPON)
+		return OptimisticScore(slot, a, objective) >= OptimisticScore(slot, b, objective);
+
+	const ItemStats &lhs = armorStats[a], &rhs = armorStats[b];
+	if (ArmorScore(lhs.defense, lhs.weight, objective) < ArmorScore(rhs.defense, rhs.weight, objective))
+		return false;
+
+	//a must protect at least as well from every element worth protecting from, and no better from the rest.
+	for (int i = 0; i < NUM_ELEMS; i++)
+	{
+		if (objective.elements[i] > 0 && lhs.elemMod[i] < rhs.elemMod[i])
+			return false;
+		if (objective.elements[i] < 0 && lhs.elemMod[i] > rhs.elemMod[i])
+			return false;
+	}
+	return true;
+}
+
+//Fill list with the items for a slot that are worth considering, best first, followed by -1 for an empty slot.
+int LoadoutOptimizer::PruneSlot(int slot, unsigned long long legal, int partySize, const int *counts,
+								const LoadoutObjective &objective, Option *list) const
+{
+	int itemCount = (slot == SLOT_WEAPON) ? weaponCount : armorCount;
+	int size = 0;
+
+	for (int b = 0; b < itemCount; b++)
+	{
+		if (!(legal & (1ULL<<b)))
+			continue;
+
+		//Nothing can make up for an item that's worse than nothing.
+		int score = OptimisticScore(slot, b, objective);
+		if (score < 0)
+			continue;
+
+		//Count the copies of better items on hand.  Identical items only shadow later ones.
+		int covered = 0;
+		for (int a = 0; a < itemCount && covered < partySize; a++)
+		{
+			if (a == b || !(legal & (1ULL<<a)))
+				continue;
+			if (Dominates(slot, a, b, objective) && (a < b || !Dominates(slot, b, a, objective)))
+				covered += counts[a];
+		}
+
+		if (covered < partySize)
+		{
+			list[size].item = b;
+			list[size].score = score;
+			size++;
+		}
+	}
+	stable_sort(list, list + size, Option::Better);
+
+	list[size].item = -1;
+	list[size].score = 0;
+	return size + 1;
+}
+
+
+
+//Every combination of the armor a job could wear, with -1 for an empty slot, scored exactly.
+void LoadoutOptimizer::BuildArmorSets(JobLists &lists, const LoadoutObjective &objective) const
+{
+	const Option *bodies = lists.slots[SLOT_BODY], *shields = lists.slots[SLOT_SHIELD];
+	const Option *helms = lists.slots[SLOT_HELM], *gloves = lists.slots[SLOT_GLOVE];
+
+	lists.armorSets.clear();
+	lists.armorSets.reserve(lists.sizes[SLOT_BODY]*lists.sizes[SLOT_SHIELD]*lists.sizes[SLOT_HELM]*lists.sizes[SLOT_GLOVE]);
+	for (int b = 0; b < lists.sizes[SLOT_BODY]; b++)
+	{
+		for (int s = 0; s < lists.sizes[SLOT_SHIELD]; s++)
+		{
+			for (int h = 0; h < lists.sizes[SLOT_HELM]; h++)
+			{
+				for (int g = 0; g < lists.sizes[SLOT_GLOVE]; g++)
+				{
+					ArmorSet set;
+					set.items[SLOT_WEAPON] = -1;
+					set.items[SLOT_BODY] = bodies[b].item;
+					set.items[SLOT_SHIELD] = shields[s].item;
+					set.items[SLOT_HELM] = helms[h].item;
+					set.items[SLOT_GLOVE] = gloves[g].item;
+
+					int score = 0;
+					int protection[NUM_ELEMS] = { 0 };
+					for (int slot = SLOT_BODY; slot < NUM_SLOTS; slot++)
+					{
+						if (set.items[slot] < 0)
+							continue;
+						const ItemStats &stats = armorStats[set.items[slot]];
+						score += ArmorScore(stats.defense, stats.weight, objective);
+						for (int i = 0; i < NUM_ELEMS; i++)
+							protection[i] = max(protection[i], stats.elemMod[i]);
+					}
+					set.score = score + ElementScore(protection, objective, false);
+
+					//Wearing nothing at all is always possible, so anything worse is never needed.
+					if (set.score >= 0)
+						lists.armorSets.push_back(set);
+				}
+			}
+		}
+	}
+	sort(lists.armorSets.begin(), lists.armorSets.end(), ArmorSet::Better);
+}
+
+
+
+/* The most a slot could add for the members from this one on.  That's the
+   lesser of what they'd get if each had their pick of what's left, and what
+   the best copies left would add up to if whoever wanted them could use
+   them; the second is what keeps the search small when the party is after
+   the same scarce items. */
+int LoadoutOptimizer::SlotBound(const SearchState &state, int slot, int member) const
+{
+	int members = state.partySize - member;
+	if (members <= 0)
+		return 0;
+
+	const int *left = (slot == SLOT_WEAPON) ? state.weaponsLeft : state.armorLeft;
+	const Option *pool = state.pool[slot];
+	int copies = 0, inventory = 0;
+	for (int i = 0; i < state.poolSizes[slot] && copies < members; i++)
+	{
+		int take = min(left[pool[i].item], members - copies);
+		inventory += take*pool[i].score;
+		copies += take;
+	}
+
+	int picks = 0;
+	for (int i = member; i < state.partySize; i++)
+	{
+		const Option *list = state.lists[i]->slots[slot];
+		for (int j = 0; ; j++)
+		{
+			if (list[j].item < 0 || left[list[j].item] > 0)
+			{
+				picks += list[j].score;
+				break;
+			}
+		}
+	}
+	return min(inventory, picks);
+}
+
+//A set of armor is never worth more than its pieces' optimistic scores, nor more than the best set that's left.
+int LoadoutOptimizer::ArmorBound(const SearchState &state, int member) const
+{
+	int slots = 0;
+	for (int slot = SLOT_BODY; slot < NUM_SLOTS; slot++)
+		slots += SlotBound(state, slot, member);
+
+	int sets = 0;
+	for (int i = member; i < state.partySize; i++)
+	{
+		const vector<ArmorSet> &armorSets = state.lists[i]->armorSets;
+		for (int a = 0; a < (int)armorSets.size(); a++)
+		{
+			const int *items = armorSets[a].items;
+			if ((items[SLOT_BODY] < 0 || state.armorLeft[items[SLOT_BODY]]) && (items[SLOT_SHIELD] < 0 || state.armorLeft[items[SLOT_SHIELD]]) &&
+				(items[SLOT_HELM] < 0 || state.armorLeft[items[SLOT_HELM]]) && (items[SLOT_GLOVE] < 0 || state.armorLeft[items[SLOT_GLOVE]]))
+			{
+				sets += armorSets[a].score;
+				break;
+			}
+		}
+	}
+	return min(slots, sets);
+}
+
+void LoadoutOptimizer::SearchWeapons(SearchState &state, int member, int score) const
+{
+	if (member == state.partySize)
+	{
+		if (score > state.bestWeaponScore)
+		{
+			state.bestWeaponScore = score;
+			for (int i = 0; i < state.partySize; i++)
+				state.bestWeapon[i] = state.weaponChoice[i];
+		}
+		return;
+	}
+
+	//Members with the same job could swap weapons, so only try them in one order.
+	const JobLists &lists = *state.lists[member];
+	int first = (member > 0 && state.lists[member - 1] == &lists) ? state.weaponChoice[member - 1] : 0;
+
+	const Option *weapons = lists.slots[SLOT_WEAPON];
+	int bound = SlotBound(state, SLOT_WEAPON, member + 1);
+	for (int w = first; w < lists.sizes[SLOT_WEAPON]; w++)
+	{
+		//The list is sorted, so nothing further down can do better.
+		if (score + weapons[w].score + bound <= state.bestWeaponScore)
+			break;
+
+		int weapon = weapons[w].item;
+		if (weapon >= 0 && state.weaponsLeft[weapon] == 0)
+			continue;
+
+		if (weapon >= 0)
+			state.weaponsLeft[weapon]--;
+		state.weaponChoice[member] = w;
+
+		//Once it's taken, the others might not be able to get what the bound above counted on.
+		int total = score + weapons[w].score;
+		if (total + SlotBound(state, SLOT_WEAPON, member + 1) > state.bestWeaponScore)
+			SearchWeapons(state, member + 1, total);
+
+		if (weapon >= 0)
+			state.weaponsLeft[weapon]++;
+	}
+}
+
+void LoadoutOptimizer::SearchArmor(SearchState &state, int member, int score) const
+{
+	if (member == state.partySize)
+	{
+		if (score > state.bestArmorScore)
+		{
+			state.bestArmorScore = score;
+			for (int i = 0; i < state.partySize; i++)
+				state.bestArmor[i] = state.armorChoice[i];
+		}
+		return;
+	}
+
+	const JobLists &lists = *state.lists[member];
+	int first = (member > 0 && state.lists[member - 1] == &lists) ? state.armorChoice[member - 1] : 0;
+
+	const vector<ArmorSet> &armorSets = lists.armorSets;
+	int bound = ArmorBound(state, member + 1);
+	for (int a = first; a < (int)armorSets.size(); a++)
+	{
+		const ArmorSet &set = armorSets[a];
+		if (score + set.score + bound <= state.bestArmorScore)
+			break;
+
+		//Make sure the items are still in the inventory.
+		bool available = true;
+		for (int slot = SLOT_BODY; slot < NUM_SLOTS; slot++)
+			if (set.items[slot] >= 0 && state.armorLeft[set.items[slot]] == 0)
+				available = false;
+		if (!available)
+			continue;
+
+		for (int slot = SLOT_BODY; slot < NUM_SLOTS; slot++)
+			if (set.items[slot] >= 0)
+				state.armorLeft[set.items[slot]]--;
+		state.armorChoice[member] = a;
+
+		int total = score + set.score;
+		if (total + ArmorBound(state, member + 1) > state.bestArmorScore)
+			SearchArmor(state, member + 1, total);
+
+		for (int slot = SLOT_BODY; slot < NUM_SLOTS; slot++)
+			if (set.items[slot] >= 0)
+				state.armorLeft[set.items[slot]]++;
+	}
+}
+
+/* Weapons and armor come out of separate inventories and add to the score
+   separately, so the best weapons and the best armor for the party are
+   searched for one after the other. */
+int LoadoutOptimizer::Optimize(const Job *party, int partySize, const int *weaponCounts, const int *armorCounts,
+							   const LoadoutObjective &objective, Loadout *result) const
+{
+	SearchState state;
+	state.partySize = min(partySize, LOADOUT_MAX_PARTY);
+
+	//Only items in the inventory are legal.
+	unsigned long long haveWeapons = 0, haveArmor = 0;
+	for (int i = 0; i < weaponCount; i++)
+		if (weaponCounts[i] > 0)
+			haveWeapons |= (1ULL<<i);
+	for (int i = 0; i < armorCount; i++)
+		if (armorCounts[i] > 0)
+			haveArmor |= (1ULL<<i);
+
+	//Group the party by job, and build each job's lists once.
+	for (int i = 0; i < state.partySize; i++)
+		state.order[i] = i;
+	for (int i = 1; i < state.partySize; i++)
+		for (int j = i; j > 0 && party[state.order[j - 1]] > party[state.order[j]]; j--)
+			swap(state.order[j - 1], state.order[j]);
+
+	int jobCount = 0;
+	for (int i = 0; i < state.partySize; i++)
+	{
+		Job job = party[state.order[i]];
+		if (i > 0 && state.lists[i - 1]->job == job)
+		{
+			state.lists[i] = state.lists[i - 1];
+			continue;
+		}
+
+		JobLists &lists = state.jobs[jobCount++];
+		lists.job = job;
+		for (int slot = 0; slot < NUM_SLOTS; slot++)
+		{
+			bool weapon = (slot == SLOT_WEAPON);
+			lists.sizes[slot] = PruneSlot(slot, jobMasks[slot][job] & (weapon ? haveWeapons : haveArmor), state.partySize,
+										  weapon ? weaponCounts : armorCounts, objective, lists.slots[slot]);
+		}
+		BuildArmorSets(lists, objective);
+		state.lists[i] = &lists;
+	}
+
+	for (int slot = 0; slot < NUM_SLOTS; slot++)
+	{
+		unsigned long long pooled = 0;
+		state.poolSizes[slot] = 0;
+		for (int i = 0; i < jobCount; i++)
+		{
+			for (int j = 0; j < state.jobs[i].sizes[slot]; j++)
+			{
+				const Option &option = state.jobs[i].slots[slot][j];
+				if (option.item >= 0 && !(pooled & (1ULL<<option.item)))
+				{
+					pooled |= (1ULL<<option.item);
+					state.pool[slot][state.poolSizes[slot]++] = option;
+				}
+			}
+		}
+		sort(state.pool[slot], state.pool[slot] + state.poolSizes[slot], Option::Better);
+	}
+
+	for (int i = 0; i < weaponCount; i++)
+		state.weaponsLeft[i] = weaponCounts[i];
+	for (int i = 0; i < armorCount; i++)
+		state.armorLeft[i] = armorCounts[i];
+
+	state.bestWeaponScore = state.bestArmorScore = INT_MIN;
+	SearchWeapons(state, 0, 0);
+	SearchArmor(state, 0, 0);
+
+	for (int i = 0; i < state.partySize; i++)
+	{
+		const JobLists &lists = *state.lists[i];
+		const Option &weapon = lists.slots[SLOT_WEAPON][state.bestWeapon[i]];
+		const ArmorSet &set = lists.armorSets[state.bestArmor[i]];
+		Loadout &loadout = result[state.order[i]];
+		for (int slot = 0; slot < NUM_SLOTS; slot++)
+			loadout.items[slot] = set.items[slot];
+		loadout.items[SLOT_WEAPON] = weapon.item;
+		loadout.score = weapon.score + set.score;
+	}
+
+	return state.bestWeaponScore + state.bestArmorScore;
+}
+
+
+
+struct LoadoutBatch
+{
+	const LoadoutOptimizer *optimizer;
+	const vector<LoadoutQuery> *queries;
+	vector<LoadoutResult> *results;
+	atomic<int> next;
+};
+
+static void LoadoutWorker(LoadoutBatch *batch)
+{
+	int counts[2][LOADOUT_MAX_ITEMS];
+
+	for (;;)
+	{
+		int index = batch->next++;
+		if (index >= (int)batch->queries->size())
+			break;
+
+		//Copy the inventory so short count lists read as zero.
+		const LoadoutQuery &query = (*batch->queries)[index];
+		for (int i = 0; i < LOADOUT_MAX_ITEMS; i++)
+		{
+			counts[0][i] = i < (int)query.weaponCounts.size() ? query.weaponCounts[i] : 0;
+			counts[1][i] = i < (int)query.armorCounts.size() ? query.armorCounts[i] : 0;
+		}
+
+		LoadoutResult &result = (*batch->results)[index];
+		result.score = batch->optimizer->Optimize(query.party, query.partySize, counts[0], counts[1],
+												  query.objective, result.loadouts);
+	}
+}
+
+void LoadoutOptimizer::OptimizeBatch(const vector<LoadoutQuery> &queries, vector<LoadoutResult> &results, int threadCount) const
+{
+	results.resize(queries.size());
+
+	if (threadCount <= 0)
+		threadCount = thread::hardware_concurrency();
+	if (threadCount > (int)queries.size())
+		threadCount = queries.size();
+	if (threadCount < 1)
+		threadCount = 1;
+
+	LoadoutBatch batch;
+	batch.optimizer = this;
+	batch.queries = &queries;
+	batch.results = &results;
+	batch.next = 0;
+
+	//The calling thread does its share of the work too.
+	vector<thread> workers;
+	for (int i = 1; i < threadCount; i++)
+		workers.push_back(thread(LoadoutWorker, &batch));
+	LoadoutWorker(&batch);
+	for (int i = 0; i < (int)workers.size(); i++)
+		workers[i].join();
+}
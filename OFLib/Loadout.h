@@ -0,0 +1,143 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* Loadout.h
+* Defines an optimizer that chooses the best legal weapon and armor for each
+* member of a party from a shared inventory.
+*****************************************************************************/
+
+#ifndef LOADOUT_H
+#define LOADOUT_H
+
+#include "Defs.h"
+#include "Items.h"
+#include <vector>
+using namespace std;
+
+#define LOADOUT_MAX_ITEMS 64 //item lists are filtered with 64-bit masks, so only this many of each kind are considered
+#define LOADOUT_MAX_PARTY 4
+
+//Equipment slots searched by the optimizer.
+#define NUM_SLOTS 5
+enum LoadoutSlot
+{
+	SLOT_WEAPON = 0,
+	SLOT_BODY = 1,
+	SLOT_SHIELD = 2,
+	SLOT_HELM = 3,
+	SLOT_GLOVE = 4
+};
+
+//Weights applied to each stat when scoring a loadout.  Weight is a penalty,
+//so a positive value favors lighter armor.  Each element weight is applied
+//to the largest elemMod among the armor worn, since protection from the
+//same element doesn't stack.
+struct LoadoutObjective
+{
+	int power, accuracy, critical;
+	int defense, weight;
+	int elements[NUM_ELEMS];
+};
+
+//The equipment chosen for one character.  The weapon slot is an index into
+//the weapon list, the others are indices into the armor list, and -1 means
+//the slot is left empty.
+struct Loadout
+{
+	int items[NUM_SLOTS];
+	int score;
+};
+
+//A complete optimization problem, used for batch queries.
+struct LoadoutQuery
+{
+	int partySize;
+	Job party[LOADOUT_MAX_PARTY];
+	vector<int> weaponCounts, armorCounts; //how many of each item are in the inventory
+	LoadoutObjective objective;
+};
+
+struct LoadoutResult
+{
+	Loadout loadouts[LOADOUT_MAX_PARTY];
+	int score; //total score for the whole party
+};
+
+
+
+/* The weapon and the armor contribute to the score independently, except
+   that elemental protection is the best over all armor worn.  The optimizer
+   therefore scores weapons on their own and enumerates every set of armor
+   each job could wear.  A branch and bound search then goes through the
+   whole lists for each member, best first, against what's left in the
+   inventory, so a scarce item going to one member leaves the others with
+   the next best things and the answer is always the true optimum.  Its
+   bound counts the best copies left of each item, which keeps it small
+   when the whole party is after the same few items, and members with the
+   same job are only tried in one order.
+
+   Items a job cannot equip are removed with one mask per job and slot.  An
+   item is also dropped when enough copies of items that dominate it are on
+   hand to equip the whole party, or when leaving the slot empty is never
+   worse, since it can then never be needed. */
+class LoadoutOptimizer
+{
+public:
+
+	LoadoutOptimizer(const vector<Weapon> &weapons, const vector<Armor> &armor);
+
+	//Returns the total score and fills in one loadout per party member.
+	//Safe to call from several threads at once.
+	int Optimize(const Job *party, int partySize, const int *weaponCounts, const int *armorCounts,
+				 const LoadoutObjective &objective, Loadout *result) const;
+
+	//Solves each query, spreading them across threads (0 = one per core).
+	void OptimizeBatch(const vector<LoadoutQuery> &queries, vector<LoadoutResult> &results, int threadCount = 0) const;
+
+private:
+
+	struct ItemStats
+	{
+		int power, accuracy, critical; //weapons
+		int defense, weight, elemMod[NUM_ELEMS]; //armor
+	};
+
+	//An item worth trying in a slot, or -1 for leaving it empty.
+	struct Option
+	{
+		int item;
+		int score; //exact for weapons; for armor, an upper bound that counts its protection in full
+
+		static bool Better(const Option &lhs, const Option &rhs) { return lhs.score > rhs.score; }
+	};
+
+	//A body, shield, helm and gloves, any of which may be -1, with their exact score.
+	struct ArmorSet
+	{
+		int items[NUM_SLOTS];
+		int score;
+
+		static bool Better(const ArmorSet &lhs, const ArmorSet &rhs) { return lhs.score > rhs.score; }
+	};
+
+	struct JobLists;
+	struct SearchState;
+
+	int PruneSlot(int slot, unsigned long long legal, int partySize, const int *counts,
+				  const LoadoutObjective &objective, Option *list) const;
+	int OptimisticScore(int slot, int item, const LoadoutObjective &objective) const;
+	bool Dominates(int slot, int a, int b, const LoadoutObjective &objective) const;
+	void BuildArmorSets(JobLists &lists, const LoadoutObjective &objective) const;
+	int SlotBound(const SearchState &state, int slot, int member) const;
+	int ArmorBound(const SearchState &state, int member) const;
+	void SearchWeapons(SearchState &state, int member, int score) const;
+	void SearchArmor(SearchState &state, int member, int score) const;
+
+	unsigned long long jobMasks[NUM_SLOTS][NUM_JOBS]; //which items each job may equip in each slot
+	ItemStats weaponStats[LOADOUT_MAX_ITEMS], armorStats[LOADOUT_MAX_ITEMS];
+	int weaponCount, armorCount;
+};
+
+#endif
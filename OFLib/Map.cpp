@@ -1,4 +1,7 @@
 #include "Map.h"
+#include "FlatFile.h"
+#include "MemoryTracker.h"
+#include "Trace.h"
 #include <fstream>
 #include <string>
 #include <cmath>
@@ -7,58 +10,232 @@ using namespace std;
 
 Map::Map(string filename)
 {
-	const string MAP_ROOT = "../Quests/FF1/Maps";
+	this->filename = filename;
+	trackedBytes = 0;
+	tileIDs = NULL;
+	chunks = NULL;
+	cache = NULL;
+	LoadTiles(filename);
+	tilesLoaded = true;
 
-	ifstream mapFile(MAP_ROOT + "/" + filename, ios::in|ios::binary);
-	
-	mapWidth = 64;
-	mapHeight = 64;
-	tileIDs = new int[mapWidth*mapHeight];
-	mapFile.read((char *)tileIDs, mapWidth*mapHeight*sizeof(int));
+	if (LoadPalette(filename))
+		outsideTileset = insideTileset = new Tileset(IndexedTilesetName(palette->GetTileset()));
+	else
+	{
+		string outside, inside;
+		FindTilesets(filename, outside, inside);
+		outsideTileset = new Tileset(outside);
+		insideTileset = new Tileset(inside);
+	}
+
+	walkMapBuilt = false;
+
+	//One more tile on each side than the screen, for when the camera is between tiles.
+	window = new TileWindow(SCREEN_WIDTH + 2, SCREEN_HEIGHT + 2);
+}
+
+Map::Map(string filename, AssetCache &cache, int priority)
+{
+	this->cache = &cache;
+	this->filename = filename;
+	trackedBytes = 0;
+	tileIDs = NULL;
+	chunks = NULL;
+	tilesLoaded = false;
+	if (cache.GetLoader())
+		cache.GetLoader()->LoadMapTiles(this, filename, priority);
+	else
+	{
+		LoadTiles(filename);
+		ReadSource();
+		tilesLoaded = true;
+	}
+
+	if (LoadPalette(filename))
+	{
+		//One reference for each pointer, so the destructor can release them both either way.
+		outsideTileset = cache.GetTileset(IndexedTilesetName(palette->GetTileset()), priority);
+		insideTileset = cache.GetTileset(IndexedTilesetName(palette->GetTileset()), priority);
+	}
+	else
+	{
+		string outside, inside;
+		FindTilesets(filename, outside, inside);
+		outsideTileset = cache.GetTileset(outside, priority);
+		insideTileset = cache.GetTileset(inside, priority);
+	}
+
+	walkMapBuilt = false;
+	window = new TileWindow(SCREEN_WIDTH + 2, SCREEN_HEIGHT + 2);
+}
 
-	outsideTileset = new Tileset("Castle");
-	insideTileset = new Tileset("Castle (Rooms)");
+//Read the map's tiles.  Doesn't touch GL, so the loader can do this on a worker thread.
+void Map::LoadTiles(string filename)
+{
+	TRACE_SCOPE("map", "Map::LoadTiles");
+	string path = MAP_ROOT + "/" + filename;
+	if (ChunkedMap::IsChunkedMap(path))
+	{
+		//Big maps like the overworld are only decoded around the camera.
+		chunks = new ChunkedMap(path);
+		mapWidth = chunks->GetWidth();
+		mapHeight = chunks->GetHeight();
+	}
+	else
+	{
+		ifstream mapFile(path, ios::in|ios::binary);
+
+		mapWidth = 64;
+		mapHeight = 64;
+		tileIDs = new int[mapWidth*mapHeight];
+		mapFile.read((char *)tileIDs, mapWidth*mapHeight*sizeof(int));
+	}
+
+	trackedBytes = chunks ? chunks->GetByteSize() : mapWidth*mapHeight*sizeof(int);
+	MemoryTracker::Get().Allocate(MEMORY_MAPS, MEMORY_CPU, filename, trackedBytes);
+}
+
+void Map::ReadSource()
+{
+	source.files.assign(1, MAP_ROOT + "/" + filename);
+	ReadFileSource(source);
+}
+
+//Maps exported with palettes share the ROM's indexed tilesets, and are colored as they're drawn.
+bool Map::LoadPalette(string filename)
+{
+	palette = NULL;
+	inRoom = false;
+	if (!PaletteShader::Get())
+		return false;
+
+	string base = filename.substr(0, filename.rfind(".map"));
+	palette = new Palette();
+	if (!palette->Load(PALETTE_ROOT + "/" + base + ".pal"))
+	{
+		delete palette;
+		palette = NULL;
+	}
+	return palette != NULL;
+}
+
+//RGB maps look up their tilesets in the exporter's manifest.  Without one, or if the map isn't in it, they get the castle's.
+void Map::FindTilesets(string filename, string &outside, string &inside)
+{
+	outside = "Castle";
+	inside = "Castle (Rooms)";
+
+	FlatFileReader manifest(TILESET_ROOT + "/" + MAP_TILESET_MANIFEST);
+	if (!manifest.headers.count("Map") || !manifest.headers.count("Tileset") || !manifest.headers.count("RoomTileset"))
+		return;
+	for (lineIterator line = manifest.lines.begin(); line != manifest.lines.end(); line++)
+	{
+		if ((*line).size() < manifest.headers.size() || (*line)[manifest.headers["Map"]] != filename)
+			continue;
+		outside = (*line)[manifest.headers["Tileset"]];
+		inside = (*line)[manifest.headers["RoomTileset"]];
+		return;
+	}
+}
+
+bool Map::IsReady() const
+{
+	return tilesLoaded && outsideTileset->IsComplete() && insideTileset->IsComplete();
+}
+
+//Just the map's own memory; the tilesets are counted separately.
+size_t Map::GetByteSize() const
+{
+	if (!tilesLoaded)
+		return 0;
+	return chunks ? chunks->GetByteSize() : mapWidth*mapHeight*sizeof(int);
 }
 
 Map::~Map()
 {
+	MemoryTracker::Get().Free(MEMORY_MAPS, MEMORY_CPU, filename, trackedBytes);
 	delete[] tileIDs;
-	delete insideTileset;
-	delete outsideTileset;
+	delete chunks;
+	delete window;
+	delete palette;
+	if (cache)
+	{
+		cache->Release(insideTileset);
+		cache->Release(outsideTileset);
+	}
+	else
+	{
+		if (outsideTileset != insideTileset)
+			delete outsideTileset;
+		delete insideTileset;
+	}
 }
 
 void Map::Draw(float centerX, float centerY)
 {
-	const float screenWidth = 16, screenHeight = 14;
+	TRACE_SCOPE("map", "Map::Draw");
+	if (!IsReady())
+		return;
 
-	int leftX = floor(centerX - screenWidth/2.0);
-	int lowerY = floor(centerY - screenHeight/2.0);
-	int rightX = ceil(centerX + screenWidth/2.0);
-	int upperY = ceil(centerY + screenHeight/2.0);
+	int leftX = floor(centerX - SCREEN_WIDTH/2.0);
+	int lowerY = floor(centerY - SCREEN_HEIGHT/2.0);
 
-	for (int x = leftX; x <= rightX; x++)
+	//Only the tiles that scrolled into view need looking up.
+	window->MoveTo(leftX, lowerY);
+	const vector<WindowCell> &exposed = window->GetExposed();
+	if (!exposed.empty())
 	{
-		for (int y = lowerY; y <= upperY; y++)
+		//Get the chunks around the camera ready before it scrolls onto them.
+		if (chunks)
 		{
-			int xMod = x % mapWidth;
-			int yMod = y % mapHeight;
-			int i = xMod < 0 ? xMod + mapWidth  : xMod;
-			int j = yMod < 0 ? yMod + mapHeight : yMod;
-
-			int tileIndex = mapWidth*(mapHeight - 1 - j) + i;
-			unsigned int texture = (*insideTileset)[tileIDs[tileIndex]];
-
-			glBindTexture(GL_TEXTURE_2D, texture);
-			glBegin(GL_QUADS);
-				glTexCoord2i(0, 0);
-				glVertex2i(x, y);
-				glTexCoord2i(0, 1);
-				glVertex2i(x, y + 1);
-				glTexCoord2i(1, 1);
-				glVertex2i(x + 1, y + 1);
-				glTexCoord2i(1, 0);
-				glVertex2i(x + 1, y);
-			glEnd();
+			int centerIndex = MapTileIndex(floor(centerX), floor(centerY), mapWidth, mapHeight);
+			chunks->Focus(centerIndex % mapWidth, centerIndex / mapWidth);
 		}
+
+		for (int i = 0; i < (int)exposed.size(); i++)
+			window->Set(exposed[i], (*insideTileset)[GetTileID(exposed[i].x, exposed[i].y)]);
+	}
+
+	if (palette)
+	{
+		PaletteShader::Get()->Begin(*palette, inRoom ? PALETTE_ROOM : PALETTE_STANDARD);
+		window->Draw();
+		PaletteShader::Get()->End();
+	}
+	else
+		window->Draw();
+}
+
+int Map::GetTileID(int x, int y)
+{
+	int tileIndex = MapTileIndex(x, y, mapWidth, mapHeight);
+	if (chunks)
+		return chunks->GetTile(tileIndex % mapWidth, tileIndex / mapWidth);
+	return tileIDs[tileIndex];
+}
+
+//The walk map covers the whole map, so for a chunked map it is only built if something asks for it.
+const WalkMap &Map::GetWalkMap()
+{
+	if (!walkMapBuilt)
+	{
+		vector<int> allTiles;
+		const int *tiles = tileIDs;
+		if (chunks)
+		{
+			allTiles.resize(mapWidth*mapHeight);
+			for (int row = 0; row < mapHeight; row++)
+				for (int col = 0; col < mapWidth; col++)
+					allTiles[row*mapWidth + col] = chunks->GetTile(col, row);
+			tiles = &allTiles[0];
+		}
+
+		//Both tilesets share their tile properties, only the palettes differ.
+		int props[256];
+		for (int i = 0; i < 256; i++)
+			props[i] = outsideTileset->GetProperties(i);
+		walkMap.Build(tiles, mapWidth, mapHeight, props, 256);
+		walkMapBuilt = true;
 	}
+	return walkMap;
 }
\ No newline at end of file
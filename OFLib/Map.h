@@ -2,21 +2,68 @@
 #define MAP_H
 
 #include "Tileset.h"
+#include "PathFinder.h"
+#include "ChunkedMap.h"
+#include "TileWindow.h"
+#include "AssetCache.h"
+#include "Palette.h"
+
+#define SCREEN_WIDTH 16 //in tiles
+#define SCREEN_HEIGHT 14
+
+const string MAP_ROOT = "../Quests/FF1/Maps";
 
 class Map
 {
 public:
 
 	Map(string filename);
+	Map(string filename, AssetCache &cache, int priority = ASSET_PRIORITY_HIGH); //shares tilesets through the cache, and loads through its loader if it has one
 	~Map();
 
+	//Whether the tiles and tilesets are all loaded.  A map draws nothing until it is.
+	bool IsReady() const;
+
+	int GetWidth() const { return mapWidth; } //only once the tiles are loaded
+	int GetHeight() const { return mapHeight; }
+
+	size_t GetByteSize() const;
+
 	void Draw(float centerX, float centerY);
 
+	//Inside a room the map is drawn with the room palette.  Only indexed maps have one.
+	void SetInRoom(bool inRoom) { this->inRoom = inRoom; }
+	bool IsIndexed() const { return palette != NULL; }
+
+	//Look up the tile at world coordinates, wrapping around the edges.
+	int GetTileID(int x, int y);
+
+	const WalkMap &GetWalkMap();
+
 private:
 
+	friend class AssetLoader;
+	friend class AssetCache;
+
+	void LoadTiles(string filename);
+	bool LoadPalette(string filename);
+	void ReadSource(); //once the tiles are loaded, on the same thread
+	static void FindTilesets(string filename, string &outside, string &inside);
+
+	string filename;
+	FileSource source; //what the tiles came from, for the cache to check
+	size_t trackedBytes; //what LoadTiles told the MemoryTracker about
+	bool tilesLoaded;
 	int mapWidth, mapHeight;
 	Tileset *insideTileset, *outsideTileset;
-	int *tileIDs;
+	AssetCache *cache; //where the tilesets came from, NULL if they're this map's own
+	Palette *palette; //NULL if the tilesets are RGB
+	bool inRoom;
+	int *tileIDs; //NULL for a chunked map
+	ChunkedMap *chunks; //NULL for a plain 64x64 map
+	TileWindow *window;
+	WalkMap walkMap;
+	bool walkMapBuilt;
 };
 
 #endif
\ No newline at end of file
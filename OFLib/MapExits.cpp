@@ -0,0 +1,135 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "MapExits.h"
+#include "AssetCache.h"
+#include "Map.h"
+#include "FlatFile.h"
+#include <sstream>
+#include <cstdlib>
+using namespace std;
+
+MapExits::MapExits(string filename)
+{
+	FlatFileReader exitFile(filename);
+	if (exitFile.headers.count("Map") == 0)
+		return; //older exports don't have exits
+
+	for (lineIterator line = exitFile.lines.begin(); line != exitFile.lines.end(); line++)
+	{
+		const vector<string> &fields = *line;
+		if (fields.size() < exitFile.headers.size())
+			continue;
+
+		MapExit exit;
+		exit.col = atoi(fields[exitFile.headers["X"]].c_str());
+		exit.row = atoi(fields[exitFile.headers["Y"]].c_str());
+		string type = fields[exitFile.headers["Type"]];
+		exit.type = EXIT_TELEPORT;
+		for (int i = EXIT_TELEPORT; i <= EXIT_WARP; i++)
+			if (type == TypeName((ExitType)i))
+				exit.type = (ExitType)i;
+		exit.destination = fields[exitFile.headers["Destination"]];
+		exit.destCol = atoi(fields[exitFile.headers["DestX"]].c_str());
+		exit.destRow = atoi(fields[exitFile.headers["DestY"]].c_str());
+		exit.inRoom = atoi(fields[exitFile.headers["InRoom"]].c_str()) != 0;
+
+		exits[fields[exitFile.headers["Map"]]].push_back(exit);
+	}
+}
+
+const vector<MapExit> &MapExits::GetExits(string mapFilename) const
+{
+	map<string, vector<MapExit> >::const_iterator found = exits.find(mapFilename);
+	return found == exits.end() ? none : found->second;
+}
+
+const MapExit *MapExits::FindExit(string mapFilename, int col, int row) const
+{
+	const vector<MapExit> &mapExits = GetExits(mapFilename);
+	for (int i = 0; i < (int)mapExits.size(); i++)
+		if (mapExits[i].col == col && mapExits[i].row == row)
+			return &mapExits[i];
+	return NULL;
+}
+
+
+
+ExitPrefetcher::ExitPrefetcher(AssetCache &cache, const MapExits &exits)
+{
+	this->cache = &cache;
+	this->exits = &exits;
+	width = height = 0;
+}
+
+ExitPrefetcher::~ExitPrefetcher()
+{
+	CancelAll();
+}
+
+void ExitPrefetcher::SetMap(string mapFilename, int width, int height)
+{
+	CancelAll();
+	this->mapFilename = mapFilename;
+	this->width = width;
+	this->height = height;
+}
+
+void ExitPrefetcher::Update(int col, int row)
+{
+	//Find the closest way to each destination.  A warp could go anywhere, so there's nothing to fetch.
+	map<string, int> closest;
+	const vector<MapExit> &mapExits = exits->GetExits(mapFilename);
+	for (int i = 0; i < (int)mapExits.size(); i++)
+	{
+		const MapExit &exit = mapExits[i];
+		if (exit.type == EXIT_WARP || exit.destination == mapFilename)
+			continue;
+
+		int distance = Distance(exit, col, row);
+		map<string, int>::iterator found = closest.find(exit.destination);
+		if (found == closest.end() || distance < found->second)
+			closest[exit.destination] = distance;
+	}
+
+	//Let go of anything that's fallen too far behind...
+	map<string, Map *>::iterator prefetch = prefetches.begin();
+	while (prefetch != prefetches.end())
+	{
+		map<string, int>::iterator near = closest.find(prefetch->first);
+		if (near == closest.end() || near->second > PREFETCH_CANCEL_RADIUS)
+		{
+			cache->Release(prefetch->second);
+			prefetches.erase(prefetch++);
+		}
+		else
+			prefetch++;
+	}
+
+	//...and start on anything that's come close.
+	for (map<string, int>::iterator i = closest.begin(); i != closest.end(); i++)
+		if (i->second <= PREFETCH_RADIUS && prefetches.count(i->first) == 0)
+			prefetches[i->first] = cache->GetMap(i->first, ASSET_PRIORITY_LOW);
+}
+
+void ExitPrefetcher::CancelAll()
+{
+	for (map<string, Map *>::iterator i = prefetches.begin(); i != prefetches.end(); i++)
+		cache->Release(i->second);
+	prefetches.clear();
+}
+
+//Steps in the longer direction, going around the edge of the map if that's shorter.
+int ExitPrefetcher::Distance(const MapExit &exit, int col, int row) const
+{
+	int dx = abs(exit.col - col);
+	int dy = abs(exit.row - row);
+	if (width - dx < dx)
+		dx = width - dx;
+	if (height - dy < dy)
+		dy = height - dy;
+	return dx > dy ? dx : dy;
+}
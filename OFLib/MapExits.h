@@ -0,0 +1,100 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* MapExits.h
+* Defines the tiles that take the player from one map to another, and a
+* prefetcher that starts loading where an exit leads before it's taken.
+*****************************************************************************/
+
+#ifndef MAPEXITS_H
+#define MAPEXITS_H
+
+#include <string>
+#include <vector>
+#include <map>
+using namespace std;
+
+class AssetCache;
+class Map;
+
+const string EXITS_FILE = "../Quests/FF1/Exits.txt";
+
+#define PREFETCH_RADIUS 8 //start loading when an exit is this many tiles away...
+#define PREFETCH_CANCEL_RADIUS 16 //...and give up once it's this far
+
+enum ExitType
+{
+	EXIT_TELEPORT, //to another map
+	EXIT_OVERWORLD, //out of a standard map to the overworld
+	EXIT_WARP //back where the last teleport came from
+};
+
+//Positions are tile columns and rows from the top of the map, as in the .map files.
+struct MapExit
+{
+	int col, row;
+	ExitType type;
+	string destination; //.map filename, empty for a warp
+	int destCol, destRow;
+	bool inRoom; //arrive inside a room
+};
+
+//Every map's exits, as read from Exits.txt.
+class MapExits
+{
+public:
+
+	MapExits(string filename = EXITS_FILE);
+
+	const vector<MapExit> &GetExits(string mapFilename) const;
+	const MapExit *FindExit(string mapFilename, int col, int row) const; //NULL if there isn't one there
+
+	static const char *TypeName(ExitType type)
+	{
+		static const char *names[] = { "Teleport", "Overworld", "Warp" };
+		return names[type];
+	}
+
+private:
+
+	map<string, vector<MapExit> > exits;
+	vector<MapExit> none;
+};
+
+/* Keeps the maps that nearby exits lead to loading in the background, at low
+   priority, so going through a door usually finds the next map already
+   there.  Moving away from an exit gives its map back to the cache, which
+   cancels the load if it hasn't started yet, or keeps the map around for
+   next time if it has. */
+class ExitPrefetcher
+{
+public:
+
+	ExitPrefetcher(AssetCache &cache, const MapExits &exits);
+	~ExitPrefetcher();
+
+	//Start over on a new map.
+	void SetMap(string mapFilename, int width, int height);
+
+	//Call whenever the player moves to another tile.
+	void Update(int col, int row);
+
+	void CancelAll();
+
+	int GetPrefetchCount() const { return prefetches.size(); }
+
+private:
+
+	int Distance(const MapExit &exit, int col, int row) const;
+
+	AssetCache *cache;
+	const MapExits *exits;
+	string mapFilename;
+	int width, height;
+
+	map<string, Map *> prefetches; //by destination
+};
+
+#endif
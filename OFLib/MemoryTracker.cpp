@@ -0,0 +1,173 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "MemoryTracker.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+using namespace std;
+
+static const char *SUBSYSTEM_NAMES[MEMORY_SUBSYSTEMS + 1] = {
+	"Tilesets", "Maps", "Palettes", "Battles", "ROM", "Loading", "Total" };
+
+MemoryTracker::MemoryTracker()
+{
+	memset(usage, 0, sizeof(usage));
+	memset(budgets, 0, sizeof(budgets));
+}
+
+MemoryTracker &MemoryTracker::Get()
+{
+	static MemoryTracker tracker;
+	return tracker;
+}
+
+void MemoryTracker::Allocate(int subsystem, int kind, string name, size_t bytes)
+{
+	lock_guard<mutex> hold(lock);
+
+	AssetMemory &asset = assets[make_pair(subsystem, name)];
+	if (asset.name.empty())
+	{
+		asset.subsystem = subsystem;
+		asset.name = name;
+		asset.bytes[MEMORY_CPU] = asset.bytes[MEMORY_GPU] = 0;
+	}
+	asset.bytes[kind] += bytes;
+
+	int rows[2] = { subsystem, MEMORY_TOTAL };
+	for (int i = 0; i < 2; i++)
+	{
+		MemoryUsage &used = usage[rows[i]][kind];
+		used.current += bytes;
+		used.peak = max(used.peak, used.current);
+	}
+}
+
+void MemoryTracker::Free(int subsystem, int kind, string name, size_t bytes)
+{
+	lock_guard<mutex> hold(lock);
+
+	map<pair<int, string>, AssetMemory>::iterator found = assets.find(make_pair(subsystem, name));
+	if (found != assets.end())
+	{
+		AssetMemory &asset = found->second;
+		asset.bytes[kind] -= min(bytes, asset.bytes[kind]);
+		if (asset.bytes[MEMORY_CPU] == 0 && asset.bytes[MEMORY_GPU] == 0)
+			assets.erase(found);
+	}
+
+	usage[subsystem][kind].current -= min(bytes, usage[subsystem][kind].current);
+	usage[MEMORY_TOTAL][kind].current -= min(bytes, usage[MEMORY_TOTAL][kind].current);
+}
+
+MemoryUsage MemoryTracker::GetUsage(int subsystem, int kind) const
+{
+	lock_guard<mutex> hold(lock);
+	return usage[subsystem][kind];
+}
+
+static bool BiggerAsset(const AssetMemory &lhs, const AssetMemory &rhs)
+{
+	return lhs.bytes[MEMORY_CPU] + lhs.bytes[MEMORY_GPU] > rhs.bytes[MEMORY_CPU] + rhs.bytes[MEMORY_GPU];
+}
+
+vector<AssetMemory> MemoryTracker::GetAssets() const
+{
+	vector<AssetMemory> list;
+	{
+		lock_guard<mutex> hold(lock);
+		for (map<pair<int, string>, AssetMemory>::const_iterator i = assets.begin(); i != assets.end(); i++)
+			list.push_back(i->second);
+	}
+	stable_sort(list.begin(), list.end(), BiggerAsset);
+	return list;
+}
+
+void MemoryTracker::ResetPeaks()
+{
+	lock_guard<mutex> hold(lock);
+	for (int i = 0; i <= MEMORY_SUBSYSTEMS; i++)
+		for (int kind = 0; kind < MEMORY_KINDS; kind++)
+			usage[i][kind].peak = usage[i][kind].current;
+}
+
+void MemoryTracker::SetBudget(int subsystem, int kind, size_t bytes)
+{
+	lock_guard<mutex> hold(lock);
+	budgets[subsystem][kind] = bytes;
+}
+
+size_t MemoryTracker::GetBudget(int subsystem, int kind) const
+{
+	lock_guard<mutex> hold(lock);
+	return budgets[subsystem][kind];
+}
+
+bool MemoryTracker::IsOverBudget(int subsystem) const
+{
+	lock_guard<mutex> hold(lock);
+	return IsOverBudgetLocked(subsystem) || IsOverBudgetLocked(MEMORY_TOTAL);
+}
+
+bool MemoryTracker::IsOverBudget() const
+{
+	lock_guard<mutex> hold(lock);
+	for (int i = 0; i <= MEMORY_SUBSYSTEMS; i++)
+		if (IsOverBudgetLocked(i))
+			return true;
+	return false;
+}
+
+bool MemoryTracker::IsOverBudgetLocked(int subsystem) const
+{
+	for (int kind = 0; kind < MEMORY_KINDS; kind++)
+		if (budgets[subsystem][kind] && usage[subsystem][kind].current > budgets[subsystem][kind])
+			return true;
+	return false;
+}
+
+//Everything in kB, with budgets of 0 left blank.
+void MemoryTracker::Report(ostream &out) const
+{
+	vector<AssetMemory> list = GetAssets();
+	lock_guard<mutex> hold(lock);
+
+	out << "Subsystem\tCPU\tCPU Peak\tCPU Budget\tGPU\tGPU Peak\tGPU Budget" << endl;
+	for (int i = 0; i <= MEMORY_SUBSYSTEMS; i++)
+	{
+		out << SUBSYSTEM_NAMES[i];
+		for (int kind = 0; kind < MEMORY_KINDS; kind++)
+		{
+			out << "\t" << usage[i][kind].current/1024 << "\t" << usage[i][kind].peak/1024 << "\t";
+			if (budgets[i][kind])
+				out << budgets[i][kind]/1024;
+		}
+		out << endl;
+	}
+
+	out << endl << "Subsystem\tAsset\tCPU\tGPU" << endl;
+	for (int i = 0; i < (int)list.size(); i++)
+		out << SUBSYSTEM_NAMES[list[i].subsystem] << "\t" << list[i].name << "\t" << list[i].bytes[MEMORY_CPU]/1024 << "\t" << list[i].bytes[MEMORY_GPU]/1024 << endl;
+}
+
+//Each mip level is half the last on each side, down to 1x1.
+size_t MemoryTracker::TextureBytes(int width, int height, int bytesPerTexel, bool mipmapped)
+{
+	size_t bytes = (size_t)width*height*bytesPerTexel;
+	while (mipmapped && (width > 1 || height > 1))
+	{
+		width = max(1, width/2);
+		height = max(1, height/2);
+		bytes += (size_t)width*height*bytesPerTexel;
+	}
+	return bytes;
+}
+
+const char *MemoryTracker::SubsystemName(int subsystem)
+{
+	return SUBSYSTEM_NAMES[subsystem];
+}
@@ -0,0 +1,100 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* MemoryTracker.h
+* Defines the accounting of the memory assets take up, on the CPU and in
+* textures, by subsystem and by asset, with budgets for the cache to keep to.
+*****************************************************************************/
+
+#ifndef MEMORYTRACKER_H
+#define MEMORYTRACKER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <cstddef>
+using namespace std;
+
+enum MemorySubsystem
+{
+	MEMORY_TILESETS,
+	MEMORY_MAPS,
+	MEMORY_PALETTES,
+	MEMORY_BATTLES,
+	MEMORY_ROM,
+	MEMORY_LOADING, //decoded images waiting to be uploaded
+	MEMORY_SUBSYSTEMS
+};
+
+#define MEMORY_TOTAL MEMORY_SUBSYSTEMS //usage and budgets across every subsystem
+
+enum MemoryKind
+{
+	MEMORY_CPU,
+	MEMORY_GPU, //estimated from what was handed to GL, since the driver doesn't say
+	MEMORY_KINDS
+};
+
+struct MemoryUsage
+{
+	size_t current, peak;
+};
+
+//What one asset has, as named by whatever allocated it.
+struct AssetMemory
+{
+	int subsystem;
+	string name;
+	size_t bytes[MEMORY_KINDS];
+};
+
+/* Whatever allocates an asset's memory calls Allocate, and Free with the
+   same subsystem, name and size when it lets it go.  Loads happen on worker
+   threads, so everything here takes a lock; it's called once per asset or
+   per tile, never per pixel.
+
+   A budget of 0 means none.  The tracker only keeps count; AssetCache::Trim
+   is what throws out unused assets until every budget is met.  Memory that's
+   in use can't be thrown out, so IsOverBudget staying true after a trim
+   means what's in use doesn't fit. */
+class MemoryTracker
+{
+public:
+
+	static MemoryTracker &Get();
+
+	void Allocate(int subsystem, int kind, string name, size_t bytes);
+	void Free(int subsystem, int kind, string name, size_t bytes);
+
+	MemoryUsage GetUsage(int subsystem, int kind) const; //MEMORY_TOTAL for everything
+	vector<AssetMemory> GetAssets() const; //biggest first
+	void ResetPeaks();
+
+	void SetBudget(int subsystem, int kind, size_t bytes);
+	size_t GetBudget(int subsystem, int kind) const;
+	bool IsOverBudget(int subsystem) const; //either kind, or the total of either kind
+	bool IsOverBudget() const; //any budget at all
+
+	//A table of every subsystem's usage and budgets, then every asset.
+	void Report(ostream &out) const;
+
+	//A texture's size in video memory, with the whole mip chain if it has one.
+	static size_t TextureBytes(int width, int height, int bytesPerTexel, bool mipmapped);
+	static const char *SubsystemName(int subsystem);
+
+private:
+
+	MemoryTracker();
+	bool IsOverBudgetLocked(int subsystem) const;
+
+	mutable mutex lock;
+	MemoryUsage usage[MEMORY_SUBSYSTEMS + 1][MEMORY_KINDS];
+	size_t budgets[MEMORY_SUBSYSTEMS + 1][MEMORY_KINDS];
+	map<pair<int, string>, AssetMemory> assets; //by subsystem and name
+};
+
+#endif
@@ -38,11 +38,27 @@ public:
 
 };
 
-//Defines an actual instance of a monster in a battle.
-class Enemy : public Monster
+//Defines an entry in the AI table.  Monsters refer to these by index, so
+//several monsters can share the same behavior.  Unused spell and ability
+//slots are -1.
+class AIScript
 {
 public:
+
+	int magChance, abilChance; //chance out of 128 to cast a spell or use an ability
+	int spells[8], abilities[4]; //cast in order, wrapping back to the start
+
+};
+
+//Defines an actual instance of a monster in a battle.  The monster's stats
+//are shared by every enemy of its kind, so an enemy only holds what changes
+//during the fight.
+class Enemy
+{
+public:
+	int monster; //index into the monster table
 	int hp;
+	int status;
 	int spellIndex, abilIndex;
 };
 
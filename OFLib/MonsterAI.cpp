@@ -0,0 +1,71 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "MonsterAI.h"
+
+MonsterAI::MonsterAI(const vector<AIScript> &scripts)
+{
+	compiled.resize(scripts.size());
+
+	for (int i = 0; i < (int)scripts.size(); i++)
+	{
+		const AIScript &script = scripts[i];
+		CompiledScript &c = compiled[i];
+
+		//The game scales each random byte to 0-128 (RandAX) before comparing it to the chance.
+		for (int j = 0; j < 8; j++)
+			c.castRolls[j] = c.abilRolls[j] = 0;
+		for (int byte = 0; byte < 256; byte++)
+		{
+			int roll = (byte*129) >> 8;
+			if (roll < script.magChance)
+				c.castRolls[byte >> 5] |= (1u << (byte & 31));
+			if (roll < script.abilChance)
+				c.abilRolls[byte >> 5] |= (1u << (byte & 31));
+		}
+
+		//Work out where each index goes next, wrapping at the end of the list or at an empty slot.
+		for (int j = 0; j < 8; j++)
+		{
+			c.spells[j] = script.spells[j];
+			int next = (j + 1) & 7;
+			c.nextSpell[j] = (script.spells[next] < 0) ? 0 : next;
+		}
+		for (int j = 0; j < 4; j++)
+		{
+			c.abilities[j] = script.abilities[j];
+			int next = (j + 1) & 3;
+			c.nextAbil[j] = (script.abilities[next] < 0) ? 0 : next;
+		}
+	}
+}
+
+bool MonsterAI::TrySpell(const CompiledScript &c, int &spellIndex, int byte, EnemyAction &action) const
+{
+	int slot = spellIndex & 7;
+	if (!Test(c.castRolls, byte) || c.spells[slot] < 0)
+		return false;
+
+	action.type = ACTION_SPELL;
+	action.id = c.spells[slot];
+	spellIndex = c.nextSpell[slot];
+	return true;
+}
+
+void MonsterAI::TryAbility(const CompiledScript &c, int &abilIndex, int byte, EnemyAction &action) const
+{
+	int slot = abilIndex & 3;
+	if (!Test(c.abilRolls, byte) || c.abilities[slot] < 0)
+	{
+		action.type = ACTION_ATTACK;
+		action.id = 0;
+		return;
+	}
+
+	action.type = ACTION_ABILITY;
+	action.id = c.abilities[slot];
+	abilIndex = c.nextAbil[slot];
+}
@@ -0,0 +1,87 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* MonsterAI.h
+* Defines the engine that decides what each enemy does on its turn, following
+* the AI scripts from the original game.
+*****************************************************************************/
+
+#ifndef MONSTERAI_H
+#define MONSTERAI_H
+
+#include "Monster.h"
+#include "Random.h"
+#include <vector>
+using namespace std;
+
+enum EnemyActionType
+{
+	ACTION_ATTACK = 0,
+	ACTION_SPELL = 1,
+	ACTION_ABILITY = 2
+};
+
+//What an enemy chose to do.  id is an index into the spell or ability table.
+struct EnemyAction
+{
+	EnemyActionType type;
+	int id;
+};
+
+/* On its turn, an enemy with a script rolls 0-128 and casts its next spell
+   if the roll is under its magic chance.  Otherwise it rolls again against
+   its ability chance, and failing that, it attacks.  Spells and abilities are
+   used in order, and the indices wrap around when they reach the end of the
+   list or an empty slot.  Muted enemies skip straight to the ability roll.
+
+   Each script is compiled ahead of time into a table keyed on the raw random
+   byte, along with the action and the following index for every slot, so a
+   turn is just a couple of bit tests and array reads. */
+class MonsterAI
+{
+public:
+
+	MonsterAI(const vector<AIScript> &scripts);
+
+	//Decide what to do.  spellIndex and abilIndex are the enemy's place in its
+	//lists, and are advanced as they are used.  Like the game, a muted enemy
+	//makes no spell roll, and the ability roll is only made if the spell roll
+	//fails, so a TableRNG stays in step.
+	template <class RNG>
+	EnemyAction Decide(int script, int &spellIndex, int &abilIndex, RNG &rng, bool muted = false) const
+	{
+		EnemyAction action;
+		if (script < 0 || script >= (int)compiled.size())
+		{
+			action.type = ACTION_ATTACK;
+			action.id = 0;
+			return action;
+		}
+
+		const CompiledScript &c = compiled[script];
+		if (!muted && TrySpell(c, spellIndex, rng.Next() & 0xFF, action))
+			return action;
+		TryAbility(c, abilIndex, rng.Next() & 0xFF, action);
+		return action;
+	}
+
+private:
+
+	struct CompiledScript
+	{
+		unsigned int castRolls[8], abilRolls[8]; //bit n is set if random byte n succeeds
+		short spells[8], abilities[4]; //action for each slot, -1 = empty
+		unsigned char nextSpell[8], nextAbil[4]; //where each index goes after it is used
+	};
+
+	static bool Test(const unsigned int *rolls, int byte) { return (rolls[byte >> 5] >> (byte & 31)) & 1; }
+
+	bool TrySpell(const CompiledScript &c, int &spellIndex, int byte, EnemyAction &action) const;
+	void TryAbility(const CompiledScript &c, int &abilIndex, int byte, EnemyAction &action) const;
+
+	vector<CompiledScript> compiled;
+};
+
+#endif
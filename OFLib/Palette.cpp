@@ -0,0 +1,190 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "Palette.h"
+#include "RenderStats.h"
+#include "MemoryTracker.h"
+#include <fstream>
+#include <cstring>
+#include <SDL/SDL.h>
+#include <SDL/SDL_opengl.h>
+using namespace std;
+
+Palette::Palette()
+{
+	tileset = 0;
+	memset(colors, 0, sizeof(colors));
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, PALETTE_COLORS, PALETTE_TEXTURE_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, colors);
+	renderStats.textureBinds++;
+	renderStats.uploadedBytes += sizeof(colors);
+	MemoryTracker::Get().Allocate(MEMORY_PALETTES, MEMORY_GPU, "Map palettes", MemoryTracker::TextureBytes(PALETTE_COLORS, PALETTE_TEXTURE_HEIGHT, 4, false));
+}
+
+Palette::~Palette()
+{
+	glDeleteTextures(1, &texture);
+	MemoryTracker::Get().Free(MEMORY_PALETTES, MEMORY_GPU, "Map palettes", MemoryTracker::TextureBytes(PALETTE_COLORS, PALETTE_TEXTURE_HEIGHT, 4, false));
+}
+
+bool Palette::Load(string filename)
+{
+	ifstream paletteFile(filename.c_str(), ios::in|ios::binary);
+	if (!paletteFile)
+		return false;
+
+	unsigned char fileColors[PALETTE_ROWS][PALETTE_COLORS][3];
+	paletteFile.read((char *)&tileset, sizeof(int));
+	paletteFile.read((char *)fileColors, sizeof(fileColors));
+	if (!paletteFile)
+		return false;
+
+	for (int row = 0; row < PALETTE_ROWS; row++)
+		SetColors(row, fileColors[row]);
+	return true;
+}
+
+void Palette::SetColors(int row, const unsigned char (*colors)[3])
+{
+	memcpy(this->colors[row], colors, sizeof(this->colors[row]));
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, PALETTE_COLORS, 1, GL_RGB, GL_UNSIGNED_BYTE, this->colors[row]);
+	renderStats.textureBinds++;
+	renderStats.uploadedBytes += sizeof(this->colors[row]);
+}
+
+
+
+//GL 2.0 isn't in the Windows headers, so everything past 1.1 comes from the driver.
+static PFNGLACTIVETEXTUREPROC pglActiveTexture;
+static PFNGLCREATESHADERPROC pglCreateShader;
+static PFNGLSHADERSOURCEPROC pglShaderSource;
+static PFNGLCOMPILESHADERPROC pglCompileShader;
+static PFNGLGETSHADERIVPROC pglGetShaderiv;
+static PFNGLDELETESHADERPROC pglDeleteShader;
+static PFNGLCREATEPROGRAMPROC pglCreateProgram;
+static PFNGLATTACHSHADERPROC pglAttachShader;
+static PFNGLLINKPROGRAMPROC pglLinkProgram;
+static PFNGLGETPROGRAMIVPROC pglGetProgramiv;
+static PFNGLDELETEPROGRAMPROC pglDeleteProgram;
+static PFNGLUSEPROGRAMPROC pglUseProgram;
+static PFNGLGETUNIFORMLOCATIONPROC pglGetUniformLocation;
+static PFNGLUNIFORM1IPROC pglUniform1i;
+static PFNGLUNIFORM1FPROC pglUniform1f;
+
+//The tile texture holds index/255 in its one channel.
+static const char *PALETTE_FRAGMENT_SHADER =
+	"uniform sampler2D tiles;\n"
+	"uniform sampler2D palette;\n"
+	"uniform float row;\n"
+	"void main()\n"
+	"{\n"
+	"	float index = floor(texture2D(tiles, gl_TexCoord[0].st).r*255.0 + 0.5);\n"
+	"	gl_FragColor = texture2D(palette, vec2((index + 0.5)/16.0, row));\n"
+	"}\n";
+
+PaletteShader::PaletteShader()
+{
+	program = 0;
+	tilesLocation = paletteLocation = rowLocation = -1;
+}
+
+PaletteShader *PaletteShader::Get()
+{
+	static PaletteShader *shader = NULL;
+	static bool tried = false;
+	if (!tried)
+	{
+		tried = true;
+		shader = new PaletteShader();
+		if (!shader->Compile())
+		{
+			delete shader;
+			shader = NULL;
+		}
+	}
+	return shader;
+}
+
+bool PaletteShader::Compile()
+{
+	pglActiveTexture = (PFNGLACTIVETEXTUREPROC)SDL_GL_GetProcAddress("glActiveTexture");
+	pglCreateShader = (PFNGLCREATESHADERPROC)SDL_GL_GetProcAddress("glCreateShader");
+	pglShaderSource = (PFNGLSHADERSOURCEPROC)SDL_GL_GetProcAddress("glShaderSource");
+	pglCompileShader = (PFNGLCOMPILESHADERPROC)SDL_GL_GetProcAddress("glCompileShader");
+	pglGetShaderiv = (PFNGLGETSHADERIVPROC)SDL_GL_GetProcAddress("glGetShaderiv");
+	pglDeleteShader = (PFNGLDELETESHADERPROC)SDL_GL_GetProcAddress("glDeleteShader");
+	pglCreateProgram = (PFNGLCREATEPROGRAMPROC)SDL_GL_GetProcAddress("glCreateProgram");
+	pglAttachShader = (PFNGLATTACHSHADERPROC)SDL_GL_GetProcAddress("glAttachShader");
+	pglLinkProgram = (PFNGLLINKPROGRAMPROC)SDL_GL_GetProcAddress("glLinkProgram");
+	pglGetProgramiv = (PFNGLGETPROGRAMIVPROC)SDL_GL_GetProcAddress("glGetProgramiv");
+	pglDeleteProgram = (PFNGLDELETEPROGRAMPROC)SDL_GL_GetProcAddress("glDeleteProgram");
+	pglUseProgram = (PFNGLUSEPROGRAMPROC)SDL_GL_GetProcAddress("glUseProgram");
+	pglGetUniformLocation = (PFNGLGETUNIFORMLOCATIONPROC)SDL_GL_GetProcAddress("glGetUniformLocation");
+	pglUniform1i = (PFNGLUNIFORM1IPROC)SDL_GL_GetProcAddress("glUniform1i");
+	pglUniform1f = (PFNGLUNIFORM1FPROC)SDL_GL_GetProcAddress("glUniform1f");
+
+	if (!pglActiveTexture || !pglCreateShader || !pglShaderSource || !pglCompileShader || !pglGetShaderiv ||
+		!pglDeleteShader || !pglCreateProgram || !pglAttachShader || !pglLinkProgram || !pglGetProgramiv ||
+		!pglDeleteProgram || !pglUseProgram || !pglGetUniformLocation || !pglUniform1i || !pglUniform1f)
+		return false;
+
+	GLuint fragmentShader = pglCreateShader(GL_FRAGMENT_SHADER);
+	pglShaderSource(fragmentShader, 1, &PALETTE_FRAGMENT_SHADER, NULL);
+	pglCompileShader(fragmentShader);
+	GLint ok = 0;
+	pglGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &ok);
+	if (!ok)
+	{
+		pglDeleteShader(fragmentShader);
+		return false;
+	}
+
+	//The program holds on to the shader for as long as it's attached, so it can be let go of now.
+	program = pglCreateProgram();
+	pglAttachShader(program, fragmentShader);
+	pglLinkProgram(program);
+	pglDeleteShader(fragmentShader);
+	pglGetProgramiv(program, GL_LINK_STATUS, &ok);
+	if (!ok)
+	{
+		pglDeleteProgram(program);
+		program = 0;
+		return false;
+	}
+
+	tilesLocation = pglGetUniformLocation(program, "tiles");
+	paletteLocation = pglGetUniformLocation(program, "palette");
+	rowLocation = pglGetUniformLocation(program, "row");
+	return true;
+}
+
+void PaletteShader::Begin(const Palette &palette, int row)
+{
+	pglActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, palette.GetTexture());
+	pglActiveTexture(GL_TEXTURE0);
+	renderStats.textureBinds++;
+
+	pglUseProgram(program);
+	pglUniform1i(tilesLocation, 0);
+	pglUniform1i(paletteLocation, 1);
+	pglUniform1f(rowLocation, (row + 0.5f)/PALETTE_TEXTURE_HEIGHT);
+}
+
+void PaletteShader::End()
+{
+	pglUseProgram(0);
+}
@@ -0,0 +1,84 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* Palette.h
+* Defines map palettes kept in a small texture, and the shader that colors
+* palette-indexed tiles from them as they're drawn.
+*****************************************************************************/
+
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <string>
+#include <sstream>
+using namespace std;
+
+const string PALETTE_ROOT = "../Quests/FF1/Graphics/Maps/Palettes";
+
+#define PALETTE_COLORS 16
+#define PALETTE_ROWS 3 //as in the ROM...
+#define PALETTE_STANDARD 0
+#define PALETTE_SPRITES 1
+#define PALETTE_ROOM 2
+#define PALETTE_TEXTURE_HEIGHT 4 //...padded out to a power of two
+
+//Where the indexed copy of a ROM tileset is exported, under TILESET_ROOT.
+inline string IndexedTilesetName(int tileset)
+{
+	ostringstream oss;
+	oss << "Indexed Tileset " << tileset;
+	return oss.str();
+}
+
+/* All of a map's palettes, one per row of a PALETTE_COLORS wide texture.
+   Changing colors, for a palette animation or anything else, only uploads
+   the one row. */
+class Palette
+{
+public:
+
+	Palette();
+	~Palette();
+
+	//Read a palette file, as written by ROM::DumpIndexedMapGraphics.  Returns false if there isn't one.
+	bool Load(string filename);
+	int GetTileset() const { return tileset; } //the ROM tileset the palettes go with
+
+	void SetColors(int row, const unsigned char (*colors)[3]);
+	const unsigned char *GetColor(int row, int index) const { return colors[row][index]; }
+
+	unsigned int GetTexture() const { return texture; }
+
+private:
+
+	int tileset;
+	unsigned char colors[PALETTE_TEXTURE_HEIGHT][PALETTE_COLORS][3];
+	unsigned int texture;
+};
+
+/* Looks up each pixel of a single-channel index texture in a palette.  It
+   needs GLSL, and the entry points are fetched from the driver the first time
+   it's used; if they're not there, Get returns NULL and maps stay with their
+   RGB tilesets. */
+class PaletteShader
+{
+public:
+
+	static PaletteShader *Get();
+
+	//Draw with row of palette until End.  The tiles have to be bound on texture unit 0.
+	void Begin(const Palette &palette, int row);
+	void End();
+
+private:
+
+	PaletteShader();
+	bool Compile();
+
+	unsigned int program;
+	int tilesLocation, paletteLocation, rowLocation;
+};
+
+#endif
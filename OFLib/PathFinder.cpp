@@ -0,0 +1,296 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "PathFinder.h"
+#include "Defs.h"
+#include <algorithm>
+#include <cstdlib>
+using namespace std;
+
+void WalkMap::Build(const int *tileIDs, int width, int height, const int *props, int tileCount)
+{
+	this->width = width;
+	this->height = height;
+
+	int size = width*height;
+	bits.assign((size + 63)/64, 0);
+	for (int i = 0; i < size; i++)
+	{
+		int tileID = tileIDs[i];
+		bool walkable = tileID >= 0 && tileID < tileCount && !(props[tileID] & TILEPROP_SOLID);
+		if (walkable)
+			bits[i >> 6] |= (1ULL << (i & 63));
+	}
+
+	FindRegions();
+}
+
+//Flood fill from each walkable tile that doesn't have a region yet.
+void WalkMap::FindRegions()
+{
+	int size = width*height;
+	regions.assign(size, -1);
+
+	vector<int> queue;
+	queue.reserve(size);
+	int regionCount = 0;
+	for (int seed = 0; seed < size; seed++)
+	{
+		if (regions[seed] >= 0 || !IsWalkableIndex(seed))
+			continue;
+
+		queue.clear();
+		queue.push_back(seed);
+		regions[seed] = regionCount;
+		for (int head = 0; head < (int)queue.size(); head++)
+		{
+			int index = queue[head];
+			int col = index % width, row = index / width;
+			int neighbors[4] = {
+				row*width + (col + width - 1) % width,
+				row*width + (col + 1) % width,
+				((row + height - 1) % height)*width + col,
+				((row + 1) % height)*width + col };
+			for (int i = 0; i < 4; i++)
+			{
+				int next = neighbors[i];
+				if (regions[next] < 0 && IsWalkableIndex(next))
+				{
+					regions[next] = regionCount;
+					queue.push_back(next);
+				}
+			}
+		}
+		regionCount++;
+	}
+}
+
+
+
+PathFinder::PathFinder(const WalkMap &walkMap)
+{
+	this->walkMap = &walkMap;
+	width = walkMap.GetWidth();
+	height = walkMap.GetHeight();
+
+	int size = width*height;
+	arrival.resize(size);
+
+	//Manhattan distance, going around the edge of the map if that is shorter.
+	colSpan.resize(2*width - 1);
+	rowSpan.resize(2*height - 1);
+	for (int dx = 1 - width; dx < width; dx++)
+		colSpan[dx + width - 1] = min(abs(dx), width - abs(dx));
+	for (int dy = 1 - height; dy < height; dy++)
+		rowSpan[dy + height - 1] = min(abs(dy), height - abs(dy));
+
+	//Saves a divide for every tile the search looks at.
+	cols.resize(size);
+	rows.resize(size);
+	for (int i = 0; i < size; i++)
+	{
+		cols[i] = i % width;
+		rows[i] = i / width;
+	}
+	for (int i = 0; i < PATH_BUCKETS; i++)
+		open[i].reserve(256);
+	ResetReached();
+
+	CachedStep empty = { 0, 0, 0, 0 };
+	cache.assign(PATH_CACHE_SIZE, empty);
+	cacheGeneration = 0;
+	ClearCache();
+}
+
+void PathFinder::ClearCache()
+{
+	cacheUsed = 0;
+	if (++cacheGeneration != 0)
+		return;
+
+	//Every generation's been used, so anything left over could look current.
+	for (int i = 0; i < (int)cache.size(); i++)
+		cache[i].generation = 0;
+	cacheGeneration = 1;
+}
+
+//Linear probing from a hash of the tile and goal.
+int PathFinder::FindCachedStep(int index, int goal) const
+{
+	unsigned int hash = (unsigned int)index*0x9E3779B1U ^ (unsigned int)goal*0x85EBCA77U;
+	int entry = (hash ^ (hash >> 16)) & (PATH_CACHE_SIZE - 1);
+	while (cache[entry].generation == cacheGeneration && (cache[entry].index != index || cache[entry].goal != goal))
+		entry = (entry + 1) & (PATH_CACHE_SIZE - 1);
+	return entry;
+}
+
+//The tile one step from another, in PathDirection order.  Rows are stored from the top down.
+inline int PathFinder::Neighbor(int index, int dir) const
+{
+	int col = cols[index], row = rows[index];
+	switch (dir)
+	{
+	case PATH_UP:
+		return (row == 0 ? height - 1 : row - 1)*width + col;
+	case PATH_DOWN:
+		return (row == height - 1 ? 0 : row + 1)*width + col;
+	case PATH_LEFT:
+		return row*width + (col == 0 ? width - 1 : col - 1);
+	default:
+		return row*width + (col == width - 1 ? 0 : col + 1);
+	}
+}
+
+//Solid tiles look like they were reached as cheaply as possible, so the search never steps onto them.
+void PathFinder::ResetReached()
+{
+	int size = width*height;
+	reached.resize(size);
+	for (int i = 0; i < size; i++)
+		reached[i] = walkMap->IsWalkableIndex(i) ? 0 : ~0U;
+	base = 1;
+}
+
+bool PathFinder::Search(int start, int goal, vector<unsigned char> &steps)
+{
+	if (!walkMap->IsWalkableIndex(goal) || walkMap->GetRegion(start) != walkMap->GetRegion(goal))
+		return false;
+
+	//Already on a path to the goal, so the rest of it is the answer.  Every tile on a remembered
+	//path is remembered along with it, up to the goal.
+	if (cache[FindCachedStep(start, goal)].generation == cacheGeneration)
+	{
+		for (int index = start; index != goal; )
+		{
+			unsigned char dir = cache[FindCachedStep(index, goal)].dir;
+			steps.push_back(dir);
+			index = Neighbor(index, dir);
+		}
+		return true;
+	}
+
+	//No path is as long as the map has tiles, so a search's marks all fit between its base and the next one.
+	unsigned int size = reached.size();
+	if (base > ~0U - 2*(size + 1))
+		ResetReached();
+	base += size + 1;
+	unsigned int unreached = base + size; //what a tile reached in 0 steps is marked with, less one for every step
+
+	//Distances to the goal, indexed by column and row.
+	const int *colDistance = &colSpan[width - 1 - cols[goal]];
+	const int *rowDistance = &rowSpan[height - 1 - rows[goal]];
+
+	for (int i = 0; i < PATH_BUCKETS; i++)
+		open[i].clear();
+	reached[start] = unreached;
+	int estimate = colDistance[cols[start]] + rowDistance[rows[start]];
+	OpenTile first = { start, 0 };
+	open[estimate % PATH_BUCKETS].push_back(first);
+
+	//Every step raises the estimate by 0, 1 or 2, so only a few buckets are ever in use.
+	//Once PATH_BUCKETS in a row come up empty, there is nothing left to search.
+	bool found = false;
+	for (int empty = 0; empty < PATH_BUCKETS && !found; estimate++)
+	{
+		vector<OpenTile> &bucket = open[estimate % PATH_BUCKETS];
+		if (bucket.empty())
+		{
+			empty++;
+			continue;
+		}
+		empty = 0;
+
+		//Taking the newest tile first favors the ones furthest along.
+		while (!bucket.empty())
+		{
+			OpenTile tile = bucket.back();
+			bucket.pop_back();
+
+			if (reached[tile.index] != unreached - tile.cost)
+				continue; //a shorter way here was already found
+			if (tile.index == goal)
+			{
+				found = true;
+				break;
+			}
+
+			//In PathDirection order.  Rows are stored from the top down.
+			int col = cols[tile.index], row = rows[tile.index];
+			int up = row == 0 ? height - 1 : row - 1, down = row == height - 1 ? 0 : row + 1;
+			int left = col == 0 ? width - 1 : col - 1, right = col == width - 1 ? 0 : col + 1;
+			int neighbors[4] = { up*width + col, down*width + col, row*width + left, row*width + right };
+			int distances[4] = {
+				colDistance[col] + rowDistance[up],
+				colDistance[col] + rowDistance[down],
+				colDistance[left] + rowDistance[row],
+				colDistance[right] + rowDistance[row] };
+
+			OpenTile next = { 0, tile.cost + 1 };
+			unsigned int mark = unreached - next.cost;
+			for (int dir = 0; dir < 4; dir++)
+			{
+				next.index = neighbors[dir];
+				if (reached[next.index] >= mark)
+					continue; //solid, or already reached at least as cheaply
+
+				reached[next.index] = mark;
+				arrival[next.index] = (unsigned char)dir;
+				open[(next.cost + distances[dir]) % PATH_BUCKETS].push_back(next);
+			}
+		}
+	}
+
+	if (!found)
+		return false;
+
+	//Walk back from the goal, filling in the steps from the end, and remembering them for next time.
+	//Opposite directions only differ in the low bit.
+	int length = unreached - reached[goal];
+	bool remember = length <= PATH_CACHE_SIZE/2;
+	if (remember && cacheUsed + length > PATH_CACHE_SIZE/2)
+		ClearCache();
+	steps.resize(steps.size() + length);
+	vector<unsigned char>::iterator step = steps.end();
+	for (int index = goal; index != start; )
+	{
+		unsigned char dir = arrival[index];
+		*--step = dir;
+		index = Neighbor(index, dir ^ 1);
+		if (remember)
+		{
+			CachedStep &entry = cache[FindCachedStep(index, goal)];
+			if (entry.generation != cacheGeneration)
+				cacheUsed++;
+			entry.index = index;
+			entry.goal = goal;
+			entry.generation = cacheGeneration;
+			entry.dir = dir;
+		}
+	}
+
+	return true;
+}
+
+bool PathFinder::FindPath(int startX, int startY, int goalX, int goalY, vector<unsigned char> &steps)
+{
+	steps.clear();
+	int start = MapTileIndex(startX, startY, width, height);
+	int goal = MapTileIndex(goalX, goalY, width, height);
+	return Search(start, goal, steps);
+}
+
+void PathFinder::FindPaths(const PathQuery *queries, int count, PathResult *results, vector<unsigned char> &steps)
+{
+	for (int i = 0; i < count; i++)
+	{
+		int start = MapTileIndex(queries[i].startX, queries[i].startY, width, height);
+		int goal = MapTileIndex(queries[i].goalX, queries[i].goalY, width, height);
+
+		results[i].first = steps.size();
+		results[i].found = Search(start, goal, steps);
+		results[i].length = steps.size() - results[i].first;
+	}
+}
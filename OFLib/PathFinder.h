@@ -0,0 +1,153 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* PathFinder.h
+* Defines a compact record of which map tiles can be walked on, and a path
+* finder that runs over it for NPC movement and auto-walk.
+*****************************************************************************/
+
+#ifndef PATHFINDER_H
+#define PATHFINDER_H
+
+#include <vector>
+using namespace std;
+
+//Find a tile in a map's tile array from world coordinates.  Maps wrap around
+//in both directions, and rows are stored from the top of the map down,
+//while y counts up from the bottom.
+inline int MapTileIndex(int x, int y, int width, int height)
+{
+	int xMod = x % width;
+	int yMod = y % height;
+	int i = xMod < 0 ? xMod + width  : xMod;
+	int j = yMod < 0 ? yMod + height : yMod;
+	return width*(height - 1 - j) + i;
+}
+
+//One bit per tile, set if the tile can be walked on.
+class WalkMap
+{
+public:
+
+	WalkMap() : width(0), height(0) {}
+
+	//props holds the tile properties (see TILEPROP_*) for each of the tileCount tile IDs.
+	void Build(const int *tileIDs, int width, int height, const int *props, int tileCount);
+
+	bool IsWalkable(int x, int y) const { return IsWalkableIndex(MapTileIndex(x, y, width, height)); }
+	bool IsWalkableIndex(int index) const { return (bits[index >> 6] >> (index & 63)) & 1; }
+
+	//Every walkable tile gets a region number, and tiles that can reach each other share one.
+	int GetRegion(int index) const { return regions[index]; }
+
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+
+private:
+
+	void FindRegions();
+
+	int width, height;
+	vector<unsigned long long> bits;
+	vector<int> regions; //-1 for solid tiles
+};
+
+
+
+//Directions for each step of a path.  Up is +y in world coordinates.
+enum PathDirection
+{
+	PATH_UP = 0,
+	PATH_DOWN = 1,
+	PATH_LEFT = 2,
+	PATH_RIGHT = 3
+};
+
+struct PathQuery
+{
+	int startX, startY, goalX, goalY;
+};
+
+//A path is stored as length directions beginning at steps[first].
+struct PathResult
+{
+	bool found;
+	int first, length;
+};
+
+#define PATH_BUCKETS 4
+#define PATH_CACHE_SIZE (1 << 15) //steps of earlier paths remembered, a power of two
+
+/* A* search over the walk map, moving in the four directions the player
+   can, with wrap-around at the map edges.  Every step costs the same, so
+   the open list is a handful of buckets keyed on the estimated length
+   instead of a heap.  Ties are broken toward the goal, which keeps the
+   search to a narrow band on open ground.  Queries between two regions
+   that can't reach each other are answered immediately.
+
+   All of the scratch memory is kept between searches.  Instead of being
+   cleared, the step counts are stored on top of a base that moves up every
+   search, so anything under it is left over from before, and a search only
+   touches the tiles it actually visits.
+
+   Every path found is remembered a step at a time, by tile and goal.  The
+   rest of a shortest path is a shortest path from wherever it's got to, so
+   an NPC that asks again every frame on its way to the same place gets its
+   answer without a search, as does anything that joins a remembered path
+   on its way to that goal.  Once the table is half full, it's emptied and
+   starts over, which like the step counts only takes moving a number up. */
+class PathFinder
+{
+public:
+
+	PathFinder(const WalkMap &walkMap); //which has to be built already, and not change while the path finder is in use
+
+	//Find one path, replacing the contents of steps.
+	bool FindPath(int startX, int startY, int goalX, int goalY, vector<unsigned char> &steps);
+
+	//Answer a batch of queries, appending every path to steps.
+	void FindPaths(const PathQuery *queries, int count, PathResult *results, vector<unsigned char> &steps);
+
+	//Forget every path found so far, so the next searches start from nothing.
+	void ClearCache();
+
+private:
+
+	//A tile waiting to be visited, and how many steps it took to get there.
+	struct OpenTile
+	{
+		int index;
+		unsigned int cost;
+	};
+
+	//One step of a path found earlier: which way it went from a tile, on its way to a goal.
+	struct CachedStep
+	{
+		int index, goal;
+		unsigned int generation; //the entry is empty unless this is cacheGeneration
+		unsigned char dir;
+	};
+
+	bool Search(int start, int goal, vector<unsigned char> &steps);
+	void ResetReached();
+	int FindCachedStep(int index, int goal) const; //the entry for a step, or the empty one it would go in
+	int Neighbor(int index, int dir) const;
+
+	const WalkMap *walkMap;
+	int width, height;
+
+	vector<int> cols, rows; //position of each tile
+	vector<unsigned int> reached; //under base if not reached this search, more the fewer steps it took, all ones if solid
+	vector<unsigned char> arrival; //direction of the last step taken to reach each tile
+	vector<int> colSpan, rowSpan; //distance covered by each difference in column or row
+	vector<OpenTile> open[PATH_BUCKETS]; //tiles to visit, bucketed by estimated path length
+	unsigned int base; //moves up past the last search's marks each search
+
+	vector<CachedStep> cache; //open addressing
+	int cacheUsed;
+	unsigned int cacheGeneration;
+};
+
+#endif
@@ -0,0 +1,31 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* Platform.h
+* Fills in the few Windows runtime functions and compiler extensions the
+* library uses, so the parts that don't need a window can also build
+* elsewhere.
+*****************************************************************************/
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+
+inline int _mkdir(const char *path) { return mkdir(path, 0777); }
+#endif
+
+//Per-thread storage for plain data.  Older Visual C++ doesn't have thread_local.
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+#endif
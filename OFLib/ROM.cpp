@@ -5,33 +5,59 @@
 *****************************************************************************/
 
 #include "ROM.h"
+#include "FlatFile.h"
+#include "Tileset.h"
+#include "MemoryTracker.h"
+#include "Trace.h"
+#include "Platform.h"
 #include <sstream>
 #include <iomanip>
-#include <direct.h>
 #include <iostream>
+#include <set>
+#include <unordered_map>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <atomic>
 
 using namespace std;
 
 //Constructors
-ROM::ROM(string filename)
+ROM::ROM(string filename, string dataPath)
 {
+	this->dataPath = dataPath;
 	in.open(filename.c_str(), ios::in|ios::binary);
+	in.seekg(0, ios::end);
+	streamoff size = in.tellg();
+	image.resize(size > 0 ? (size_t)size : 0);
+	in.seekg(0, ios::beg);
+	if (!image.empty())
+		in.read((char *)&image[0], image.size());
 
-	LoadTextTables("StandardTable.tbl", "DTETable.tbl");
-	LoadNESPalette("FFHackster.pal");
+	LoadTextTables(dataPath + "/" + STANDARD_TABLE_FILE, dataPath + "/" + DTE_TABLE_FILE);
+	LoadNames();
+	LoadNESPalette(dataPath + "/" + NES_PALETTE_FILE);
 
 	LoadBattleGraphics();
 	LoadMapGraphics();
 
+	aiScripts = LoadAIScripts();
 	monsters = LoadMonsters();
 	battles = LoadBattles();
 	weapons = LoadWeapons();
 	armor = LoadArmor();
 	spells = LoadSpells();
+
+	BuildIndexes();
+
+	//The tables are fixed arrays, so the object itself is most of it.
+	MemoryTracker::Get().Allocate(MEMORY_ROM, MEMORY_CPU, "ROM", sizeof(ROM) + image.capacity());
 }
 
 ROM::~ROM()
 {
+	MemoryTracker::Get().Free(MEMORY_ROM, MEMORY_CPU, "ROM", sizeof(ROM) + image.capacity());
 	in.close();
 }
 
@@ -39,11 +65,13 @@ ROM::~ROM()
 
 void ROM::ExportFull()
 {
+	TRACE_SCOPE("rom", "ROM::ExportFull");
 	_mkdir(QUEST_ROOT.c_str());
 	_mkdir((QUEST_ROOT + "/Graphics").c_str());
 
 	DumpMonsterGraphics(QUEST_ROOT + "/Graphics/Monsters");
 	DumpMapGraphics(QUEST_ROOT + "/Graphics/Maps");
+	DumpIndexedMapGraphics(QUEST_ROOT + "/Graphics/Maps");
 
 	DumpMonsterData(QUEST_ROOT + "/Monsters.txt");
 	DumpWeaponData(QUEST_ROOT + "/Weapons.txt");
@@ -51,6 +79,307 @@ void ROM::ExportFull()
 	//DumpSpellData(QUEST_ROOT + "/Spells.txt");
 
 	DumpMapData(QUEST_ROOT + "/Maps");
+	DumpOverworldData(QUEST_ROOT + "/Maps/" + OVERWORLD_FILENAME);
+	DumpExitData(QUEST_ROOT + "/Exits.txt");
+
+	WriteExportManifest(QUEST_ROOT + "/" + EXPORT_MANIFEST, FindSectionChecksums());
+}
+
+/*
+An incremental export checksums every part of the ROM each group of outputs
+is made from, and compares them with the manifest the last export left next
+to its output.  Only the outputs whose checksums changed are written again,
+so a one-byte edit to a map only rewrites that map.  A group with any of its
+files missing is written again too, whatever the manifest says.
+*/
+void ROM::ExportIncremental()
+{
+	TRACE_SCOPE("rom", "ROM::ExportIncremental");
+	map<string, unsigned long long> previous = ReadExportManifest(QUEST_ROOT + "/" + EXPORT_MANIFEST);
+	map<string, unsigned long long> current = FindSectionChecksums();
+	if (previous.empty())
+	{
+		ExportFull();
+		return;
+	}
+
+	map<string, vector<string> > outputs = FindSectionOutputs();
+	vector<string> changed;
+	for (map<string, unsigned long long>::iterator i = current.begin(); i != current.end(); i++)
+	{
+		map<string, unsigned long long>::iterator last = previous.find(i->first);
+		if (last == previous.end() || last->second != i->second)
+		{
+			changed.push_back(i->first);
+			continue;
+		}
+
+		const vector<string> &files = outputs[i->first];
+		for (int j = 0; j < (int)files.size(); j++)
+		{
+			if (!FileExists(files[j]))
+			{
+				changed.push_back(i->first);
+				break;
+			}
+		}
+	}
+	set<string> dirty(changed.begin(), changed.end());
+
+	_mkdir(QUEST_ROOT.c_str());
+	_mkdir((QUEST_ROOT + "/Graphics").c_str());
+
+	if (dirty.count("Monster Graphics"))
+		DumpMonsterGraphics(QUEST_ROOT + "/Graphics/Monsters");
+	if (dirty.count("Map Graphics"))
+	{
+		DumpMapGraphics(QUEST_ROOT + "/Graphics/Maps");
+		DumpIndexedMapGraphics(QUEST_ROOT + "/Graphics/Maps");
+	}
+
+	//The monster table names each monster's sprite, which only DumpMonsterGraphics works out.  If
+	//the graphics didn't change, neither did the names, so they can come from the last export.
+	if (dirty.count("Monsters") || dirty.count("Monster Graphics"))
+	{
+		if (!dirty.count("Monster Graphics"))
+		{
+			FlatFileReader lastMonsters(QUEST_ROOT + "/Monsters.txt");
+			monsterSpriteFiles.assign(MONSTER_ENTRIES, "");
+			if (lastMonsters.headers.count("Sprite") && lastMonsters.headers.count("MonsterID"))
+			{
+				for (lineIterator line = lastMonsters.lines.begin(); line != lastMonsters.lines.end(); line++)
+				{
+					if ((*line).size() < lastMonsters.headers.size())
+						continue;
+					int monster = atoi((*line)[lastMonsters.headers["MonsterID"]].c_str());
+					if (monster >= 0 && monster < MONSTER_ENTRIES)
+						monsterSpriteFiles[monster] = (*line)[lastMonsters.headers["Sprite"]];
+				}
+			}
+		}
+		DumpMonsterData(QUEST_ROOT + "/Monsters.txt");
+	}
+	if (dirty.count("Weapons"))
+		DumpWeaponData(QUEST_ROOT + "/Weapons.txt");
+	if (dirty.count("Armor"))
+		DumpArmorData(QUEST_ROOT + "/Armor.txt");
+
+	_mkdir((QUEST_ROOT + "/Maps").c_str());
+	for (int mapIndex = 0; mapIndex < MAP_ENTRIES; mapIndex++)
+		if (dirty.count(string("Map ") + MAP_NAMES[mapIndex]))
+			DumpMap(QUEST_ROOT + "/Maps", mapIndex);
+	if (dirty.count("Overworld"))
+		DumpOverworldData(QUEST_ROOT + "/Maps/" + OVERWORLD_FILENAME);
+	if (dirty.count("Exits"))
+		DumpExitData(QUEST_ROOT + "/Exits.txt");
+
+	for (int i = 0; i < (int)changed.size(); i++)
+		cout << "Exported " << changed[i] << endl;
+
+	WriteExportManifest(QUEST_ROOT + "/" + EXPORT_MANIFEST, current);
+}
+
+//Checksums of everything each group of outputs is made from, by section name.
+map<string, unsigned long long> ROM::FindSectionChecksums()
+{
+	TRACE_SCOPE("rom", "ROM::FindSectionChecksums");
+	map<string, unsigned long long> checksums;
+
+	unsigned long long tables = HashFile(dataPath + "/" + DTE_TABLE_FILE, HashFile(dataPath + "/" + STANDARD_TABLE_FILE));
+	unsigned long long nesPalette = HashFile(dataPath + "/" + NES_PALETTE_FILE);
+
+	unsigned long long hash = HashNames(monsterNames, tables ^ nesPalette);
+	hash = HashRegion(BATTLE_OFFSET, BATTLE_ENTRIES*BATTLE_SIZE, hash);
+	hash = HashRegion(BATTLE_PALETTE_OFFSET, BATTLE_PALETTE_ENTRIES*BATTLE_PALETTE_SIZE, hash);
+	hash = HashRegion(BATTLE_TILESET_OFFSET, BATTLE_TILESET_ENTRIES*BATTLE_TILESET_TILE_ENTRIES*BATTLE_TILE_SIZE, hash);
+	checksums["Monster Graphics"] = hash;
+
+	hash = HashNames(monsterNames, tables);
+	hash = HashRegion(MONSTER_OFFSET, MONSTER_ENTRIES*MONSTER_SIZE, hash);
+	hash = HashRegion(AI_OFFSET, AI_ENTRIES*AI_SIZE, hash);
+	checksums["Monsters"] = hash;
+
+	hash = HashNames(weaponNames, tables);
+	hash = HashRegion(WEAPON_OFFSET, WEAPON_ENTRIES*WEAPON_SIZE, hash);
+	hash = HashRegion(WEAPON_PRICE_OFFSET, 2*WEAPON_ENTRIES, hash);
+	hash = HashRegion(WEAPON_PERMS_OFFSET, 2*WEAPON_ENTRIES, hash);
+	checksums["Weapons"] = hash;
+
+	hash = HashNames(armorNames, tables);
+	hash = HashRegion(ARMOR_OFFSET, ARMOR_ENTRIES*ARMOR_SIZE, hash);
+	hash = HashRegion(ARMOR_PRICE_OFFSET, 2*ARMOR_ENTRIES, hash);
+	hash = HashRegion(ARMOR_PERMS_OFFSET, 2*ARMOR_ENTRIES, hash);
+	checksums["Armor"] = hash;
+
+	hash = HashRegion(MAP_PALETTE_OFFSET, MAP_PALETTE_ENTRIES*MAP_PALETTE_SIZE, nesPalette);
+	hash = HashRegion(MAP_TILESET_OFFSET, MAP_TILESET_ENTRIES*MAP_TILESET_TILE_ENTRIES*MAP_TILE_SIZE, hash);
+	hash = HashRegion(MAP_TILESET_PATTERN_OFFSET, MAP_TILESET_ENTRIES*MAP_TILESET_PATTERN_ENTRIES*MAP_TILESET_PATTERN_SIZE, hash);
+	hash = HashRegion(MAP_TILESET_PALETTE_ASSIGNMENT_OFFSET, MAP_TILESET_ENTRIES*MAP_TILESET_PATTERN_ENTRIES, hash);
+	hash = HashRegion(MAP_TILESET_PROPERTY_OFFSET, MAP_TILESET_ENTRIES*MAP_TILESET_PATTERN_ENTRIES*MAP_TILESET_PROPERTY_SIZE, hash);
+	hash = HashRegion(MAP_TILESET_ASSIGNMENT_OFFSET, MAP_ENTRIES, hash);
+	checksums["Map Graphics"] = hash;
+
+	//The RLE streams don't say how long they are until they're decoded, so the maps are checksummed decoded.
+	unsigned long long allMaps = FNV_OFFSET_BASIS;
+	vector<int> tileIDs(MAP_ENTRIES*MAP_WIDTH*MAP_HEIGHT);
+	DecodeAllMaps(&tileIDs[0]);
+	for (int mapIndex = 0; mapIndex < MAP_ENTRIES; mapIndex++)
+	{
+		hash = HashBytes(&tileIDs[mapIndex*MAP_WIDTH*MAP_HEIGHT], MAP_WIDTH*MAP_HEIGHT*sizeof(int));
+		checksums[string("Map ") + MAP_NAMES[mapIndex]] = hash;
+		allMaps = HashBytes(&hash, sizeof(hash), allMaps);
+	}
+
+	vector<int> overworldIDs(OVERWORLD_WIDTH*OVERWORLD_HEIGHT);
+	DecodeOverworld(&overworldIDs[0]);
+	hash = HashBytes(&overworldIDs[0], overworldIDs.size()*sizeof(int));
+	checksums["Overworld"] = hash;
+	allMaps = HashBytes(&hash, sizeof(hash), allMaps);
+
+	hash = HashRegion(NORM_TELE_OFFSET, 3*NORM_TELE_ENTRIES, allMaps);
+	hash = HashRegion(ENTR_TELE_OFFSET, 3*ENTR_TELE_ENTRIES, hash);
+	hash = HashRegion(EXIT_TELE_OFFSET, 2*EXIT_TELE_ENTRIES, hash);
+	hash = HashRegion(MAP_TILESET_ASSIGNMENT_OFFSET, MAP_ENTRIES, hash);
+	hash = HashRegion(MAP_TILESET_PROPERTY_OFFSET, MAP_TILESET_ENTRIES*MAP_TILESET_PATTERN_ENTRIES*MAP_TILESET_PROPERTY_SIZE, hash);
+	hash = HashRegion(OVERWORLD_TILE_PROPERTY_OFFSET, OVERWORLD_TILE_ENTRIES*MAP_TILESET_PROPERTY_SIZE, hash);
+	checksums["Exits"] = hash;
+
+	return checksums;
+}
+
+/*
+The files each group of outputs was written to.  Some of their names are only
+known from the other files the export wrote, so if those are gone, they're
+what's listed as missing.
+*/
+map<string, vector<string> > ROM::FindSectionOutputs()
+{
+	map<string, vector<string> > outputs;
+
+	outputs["Monsters"].push_back(QUEST_ROOT + "/Monsters.txt");
+	outputs["Weapons"].push_back(QUEST_ROOT + "/Weapons.txt");
+	outputs["Armor"].push_back(QUEST_ROOT + "/Armor.txt");
+	outputs["Exits"].push_back(QUEST_ROOT + "/Exits.txt");
+	outputs["Overworld"].push_back(QUEST_ROOT + "/Maps/" + OVERWORLD_FILENAME);
+	for (int mapIndex = 0; mapIndex < MAP_ENTRIES; mapIndex++)
+		outputs[string("Map ") + MAP_NAMES[mapIndex]].push_back(QUEST_ROOT + "/Maps/" + MAP_NAMES[mapIndex] + ".map");
+
+	//The monster table names the sprites, since they're shared between monsters that look the same.
+	//It names one for every monster, but only the ones DumpMonsterGraphics draws are written.
+	string monsterPath = QUEST_ROOT + "/Graphics/Monsters";
+	vector<string> &monsterGraphics = outputs["Monster Graphics"];
+	monsterGraphics.push_back(QUEST_ROOT + "/Monsters.txt");
+	FlatFileReader lastMonsters(QUEST_ROOT + "/Monsters.txt");
+	if (lastMonsters.headers.count("Sprite") && lastMonsters.headers.count("MonsterID"))
+	{
+		for (lineIterator line = lastMonsters.lines.begin(); line != lastMonsters.lines.end(); line++)
+		{
+			if ((*line).size() < lastMonsters.headers.size())
+				continue;
+			int monster = atoi((*line)[lastMonsters.headers["MonsterID"]].c_str());
+			if (monster >= 0 && monster < MONSTER_ENTRIES - 9 && !GetBattlesWithMonster(monster).empty())
+				monsterGraphics.push_back(monsterPath + "/" + (*line)[lastMonsters.headers["Sprite"]]);
+		}
+	}
+	const char *bosses[] = { "LICH", "KARY", "KRAKEN", "TIAMAT", "CHAOS" };
+	for (int i = 0; i < 5; i++)
+		monsterGraphics.push_back(monsterPath + "/" + bosses[i] + ".bmp");
+
+	//The RGB tilesets, each with a sheet of all its tiles, are the ones the tileset manifest lists.
+	//Every tileset lists its tiles.
+	string mapPath = QUEST_ROOT + "/Graphics/Maps";
+	vector<string> &mapGraphics = outputs["Map Graphics"];
+	mapGraphics.push_back(mapPath + "/" + MAP_TILESET_MANIFEST);
+	set<string> tilesets;
+	FlatFileReader manifest(mapPath + "/" + MAP_TILESET_MANIFEST);
+	if (manifest.headers.count("Tileset") && manifest.headers.count("RoomTileset"))
+	{
+		for (lineIterator line = manifest.lines.begin(); line != manifest.lines.end(); line++)
+		{
+			if ((*line).size() < manifest.headers.size())
+				continue;
+			tilesets.insert((*line)[manifest.headers["Tileset"]]);
+			tilesets.insert((*line)[manifest.headers["RoomTileset"]]);
+		}
+	}
+	for (set<string>::iterator name = tilesets.begin(); name != tilesets.end(); name++)
+		mapGraphics.push_back(mapPath + "/" + *name + ".bmp");
+	for (int tileset = 0; tileset < MAP_TILESET_ENTRIES; tileset++)
+		tilesets.insert(IndexedTilesetName(tileset));
+	for (set<string>::iterator name = tilesets.begin(); name != tilesets.end(); name++)
+	{
+		string tilesetPath = mapPath + "/" + *name;
+		mapGraphics.push_back(tilesetPath + "/" + *name + ".txt");
+		FlatFileReader tilesetFile(tilesetPath + "/" + *name + ".txt");
+		if (tilesetFile.headers.count("Filename") == 0)
+			continue;
+		for (lineIterator line = tilesetFile.lines.begin(); line != tilesetFile.lines.end(); line++)
+			if ((*line).size() >= tilesetFile.headers.size())
+				mapGraphics.push_back(tilesetPath + "/" + (*line)[tilesetFile.headers["Filename"]]);
+	}
+	for (int mapIndex = 0; mapIndex < MAP_ENTRIES; mapIndex++)
+		mapGraphics.push_back(mapPath + "/Palettes/" + MAP_NAMES[mapIndex] + ".pal");
+
+	return outputs;
+}
+
+bool ROM::FileExists(string filename)
+{
+	ifstream file(filename.c_str(), ios::in|ios::binary);
+	return file.is_open();
+}
+
+//Anything past the end of the ROM hashes as if it weren't there.
+unsigned long long ROM::HashRegion(int offset, int size, unsigned long long hash)
+{
+	if (offset < 0 || offset >= (int)image.size())
+		return hash;
+	if (offset + size > (int)image.size())
+		size = image.size() - offset;
+	return HashBytes(&image[offset], size, hash);
+}
+
+unsigned long long ROM::HashNames(const vector<StringRef> &names, unsigned long long hash)
+{
+	for (int i = 0; i < (int)names.size(); i++)
+	{
+		hash = HashBytes(&names[i].length, sizeof(size_t), hash);
+		hash = HashBytes(names[i].data, names[i].length, hash);
+	}
+	return hash;
+}
+
+//Returns nothing if there's no manifest, or it came from a different version of the exporter.
+map<string, unsigned long long> ROM::ReadExportManifest(string filename)
+{
+	map<string, unsigned long long> checksums;
+	FlatFileReader manifest(filename);
+	if (manifest.headers.count("Section") == 0 || manifest.headers.count("Checksum") == 0)
+		return checksums;
+
+	for (lineIterator line = manifest.lines.begin(); line != manifest.lines.end(); line++)
+	{
+		if ((*line).size() < manifest.headers.size())
+			continue;
+		unsigned long long checksum;
+		istringstream iss((*line)[manifest.headers["Checksum"]]);
+		iss >> hex >> checksum;
+		checksums[(*line)[manifest.headers["Section"]]] = checksum;
+	}
+
+	map<string, unsigned long long>::iterator version = checksums.find("Version");
+	if (version == checksums.end() || version->second != EXPORT_MANIFEST_VERSION)
+		checksums.clear();
+	return checksums;
+}
+
+void ROM::WriteExportManifest(string filename, const map<string, unsigned long long> &checksums)
+{
+	ofstream out(filename.c_str());
+	out << "Section\tChecksum" << endl;
+	out << "Version\t" << hex << EXPORT_MANIFEST_VERSION << endl;
+	for (map<string, unsigned long long>::const_iterator i = checksums.begin(); i != checksums.end(); i++)
+		out << i->first << '\t' << hex << setw(16) << setfill('0') << i->second << endl;
 }
 
 
@@ -58,6 +387,7 @@ void ROM::ExportFull()
 //Load a 64-color NES palette from a file.
 void ROM::LoadNESPalette(string filename)
 {
+	TRACE_SCOPE("rom", "ROM::LoadNESPalette");
 	ifstream palFile(filename.c_str(), ios::in|ios::binary);
 	palFile.read((char *)NESpalette, NES_PALETTE_ENTRIES*3);
 	palFile.close();
@@ -115,6 +445,7 @@ byte 14-15: Same as bytes 6 to 9, but for the "alternate" enemy formation.
 
 vector<BattleDef> ROM::LoadBattles()
 {
+	TRACE_SCOPE("rom", "ROM::LoadBattles");
 	vector<BattleDef> battleList;
 	unsigned char data[BATTLE_ENTRIES][BATTLE_SIZE];
 
@@ -172,6 +503,7 @@ vector<BattleDef> ROM::LoadBattles()
 
 void ROM::LoadBattleGraphics()
 {
+	TRACE_SCOPE("rom", "ROM::LoadBattleGraphics");
 	in.seekg(BATTLE_PALETTE_OFFSET, ios::beg);
 	in.read((char *)battlePalettes, BATTLE_PALETTE_ENTRIES*BATTLE_PALETTE_SIZE);
 	in.seekg(BATTLE_TILESET_OFFSET, ios::beg);
@@ -234,6 +566,83 @@ void ROM::BuildRGBMonsterSprite(unsigned char *&sprite, int tileset, int palnum,
 	//If you thought that was bad, wait until you see the boss graphics!
 }
 
+//The same picture as BuildRGBMonsterSprite, into a wider RGBA image (pitch pixels across), with color 0 clear.
+void ROM::BuildRGBAMonsterSprite(unsigned char *rgba, int pitch, int tileset, int palnum, int picnum)
+{
+	const unsigned char picindex[4] = { 0x12, 0x22, 0x32, 0x56 };
+	int size = picnum < 2 ? 4 : 6;
+	int tilenum = picindex[picnum];
+
+	unsigned char palette[BATTLE_PALETTE_SIZE][4];
+	for (int i = 0; i < BATTLE_PALETTE_SIZE; i++)
+	{
+		for (int j = 0; j < 3; j++)
+			palette[i][j] = NESpalette[battlePalettes[palnum][i]][j];
+		palette[i][3] = i == 0 ? 0 : 255;
+	}
+
+	for (int y = 0; y < size; y++)
+		for (int x = 0; x < size; x++)
+		{
+			const unsigned char *tile = battleTilesets[tileset][tilenum++];
+			for (int i = 0; i < 8; i++)
+			{
+				unsigned char *row = &rgba[4*(pitch*(8*y + i) + 8*x)];
+				for (int j = 0; j < 8; j++) //the MSB is the leftmost pixel
+				{
+					int pixel = ((tile[i] >> (7 - j)) & 1) + (((tile[i + 8] >> (7 - j)) & 1) << 1);
+					memcpy(&row[4*j], palette[pixel], 4);
+				}
+			}
+		}
+}
+
+/*
+The atlas gives each of a battle's four groups a BATTLE_ATLAS_CELL square,
+two across and two down, in the palette the battle gives it.  A boss has the
+whole atlas to itself.  Fiend battles pick their fiend with the first
+group's graphic, Lich through Tiamat.
+*/
+void ROM::BuildBattleAtlas(const BattleDef &def, BattleAtlas &atlas)
+{
+	memset(atlas.pixels, 0, sizeof(atlas.pixels));
+
+	if (def.formation == FORM_FIEND || def.formation == FORM_CHAOS)
+	{
+		MonsterPic monpic = def.formation == FORM_CHAOS ? MONPIC_CHAOS : (MonsterPic)(MONPIC_LICH + def.monsterPics[0]);
+		AtlasRect rect = { 0, 0, monpic == MONPIC_CHAOS ? 112 : 64, monpic == MONPIC_CHAOS ? 96 : 64 };
+
+		//The boss sprite comes out as plain RGB, so the backdrop color, and the black of its blank palettes, are clear.
+		unsigned char *sprite;
+		BuildRGBBossSprite(sprite, def.tileset, def.palettes[0], def.palettes[1], monpic);
+		const unsigned char *backdrop = NESpalette[battlePalettes[def.palettes[0]][0]];
+		for (int i = 0; i < rect.width*rect.height; i++)
+		{
+			const unsigned char *src = &sprite[3*i];
+			unsigned char *dest = &atlas.pixels[4*((i/rect.width)*BATTLE_ATLAS_SIZE + i % rect.width)];
+			bool clear = (src[0] == 0 && src[1] == 0 && src[2] == 0) || memcmp(src, backdrop, 3) == 0;
+			memcpy(dest, src, 3);
+			dest[3] = clear ? 0 : 255;
+		}
+		delete[] sprite;
+
+		atlas.groups[0] = rect;
+		atlas.groupCount = 1;
+		return;
+	}
+
+	for (int group = 0; group < BATTLE_GROUPS; group++)
+	{
+		int picnum = def.monsterPics[group];
+		int size = picnum < 2 ? BATTLE_SMALL_SIZE : BATTLE_LARGE_SIZE;
+		AtlasRect rect = { BATTLE_ATLAS_CELL*(group % 2), BATTLE_ATLAS_CELL*(group/2), size, size };
+		BuildRGBAMonsterSprite(&atlas.pixels[4*(rect.y*BATTLE_ATLAS_SIZE + rect.x)], BATTLE_ATLAS_SIZE,
+			def.tileset, def.palettes[def.monsterPalettes[group]], picnum);
+		atlas.groups[group] = rect;
+	}
+	atlas.groupCount = BATTLE_GROUPS;
+}
+
 void ROM::BuildRGBBossSprite(unsigned char *&sprite, int tileset, int palnum1, int palnum2, MonsterPic monpic)
 {
 	//Determine the size of the boss (regular fiend or chaos).
@@ -384,28 +793,119 @@ void ROM::WriteBMPImage(unsigned char *sprite, int width, int height, string fil
 	bmpFile.close();
 }
 
+//An 8-bit BMP, with colorCount colors in its color table.
+void ROM::WriteIndexedBMPImage(unsigned char *sprite, int width, int height, const unsigned char (*colors)[3], int colorCount, string filename)
+{
+	ofstream bmpFile(filename.c_str(), ios::out|ios::binary);
+	int temp; short temps;
+	int rowSize = (width + 3) & ~3; //rows are padded to 4 bytes
+	int headerSize = 14 + 40 + 4*colorCount;
+
+	temps = 19778; bmpFile.write((char *)&temps, sizeof(short)); //identifier
+	temp = headerSize + rowSize*height; bmpFile.write((char *)&temp, sizeof(int)); //size of file
+	temp = 0; bmpFile.write((char *)&temp, sizeof(int)); //reserved
+	temp = headerSize; bmpFile.write((char *)&temp, sizeof(int)); //offset of pixel data
+
+	temp = 40; bmpFile.write((char *)&temp, sizeof(int)); //size of V3 BMP header
+	temp = width; bmpFile.write((char *)&temp, sizeof(int)); //width and height of image
+	temp = height; bmpFile.write((char *)&temp, sizeof(int));
+	temps = 1; bmpFile.write((char *)&temps, sizeof(short)); //color planes (must be 1)
+	temps = 8; bmpFile.write((char *)&temps, sizeof(short)); //color depth (8-bit)
+	temp = 0; bmpFile.write((char *)&temp, sizeof(int)); //compression method (none)
+	temp = rowSize*height; bmpFile.write((char *)&temp, sizeof(int)); //pixel data size
+	temp = 0; bmpFile.write((char *)&temp, sizeof(int)); //pixels per meter (ignored)
+	temp = 0; bmpFile.write((char *)&temp, sizeof(int));
+	temp = colorCount; bmpFile.write((char *)&temp, sizeof(int)); //color palette size
+	temp = 0; bmpFile.write((char *)&temp, sizeof(int)); //number of colors used (ignored)
+
+	//The color table is BGR plus a padding byte.
+	for (int i = 0; i < colorCount; i++)
+	{
+		unsigned char entry[4] = { colors[i][2], colors[i][1], colors[i][0], 0 };
+		bmpFile.write((char *)entry, 4);
+	}
+
+	//Write the rows in reverse order (from bottom to top).
+	char padding[3] = { 0, 0, 0 };
+	for (int row = height - 1; row >= 0; row--)
+	{
+		bmpFile.write((char *)&(sprite[width*row]), width);
+		bmpFile.write(padding, rowSize - width);
+	}
+
+	bmpFile.close();
+}
+
+/*
+Lots of exported images come out byte for byte the same: blank tiles, tiles
+that don't use the colors two palettes differ in, monsters that share art.
+Each one is hashed (along with its size, colors and where it's going) and
+only the first is written.  Images with the same hash are compared byte for
+byte before one is reused.  Returns the name to use for the image from
+directory, which is the earlier file's if there was one.
+*/
+static void AppendBytes(vector<unsigned char> &bytes, const void *data, size_t size)
+{
+	bytes.insert(bytes.end(), (const unsigned char *)data, (const unsigned char *)data + size);
+}
+
+string ROM::WriteSharedBMPImage(unsigned char *sprite, int width, int height, const unsigned char (*colors)[3], int colorCount,
+	string root, string directory, string filename)
+{
+	int channels = colors ? 1 : 3;
+	int rootLength = root.size();
+	vector<unsigned char> bytes;
+	AppendBytes(bytes, &rootLength, sizeof(int));
+	AppendBytes(bytes, root.c_str(), root.size());
+	AppendBytes(bytes, &width, sizeof(int));
+	AppendBytes(bytes, &height, sizeof(int));
+	AppendBytes(bytes, &colorCount, sizeof(int));
+	if (colors)
+		AppendBytes(bytes, colors, 3*colorCount);
+	AppendBytes(bytes, sprite, channels*width*height);
+	unsigned long long hash = HashBytes(&bytes[0], bytes.size());
+
+	typedef multimap<unsigned long long, ExportedImage>::iterator ImageIterator;
+	pair<ImageIterator, ImageIterator> found = exportedImages.equal_range(hash);
+	for (ImageIterator i = found.first; i != found.second; i++)
+	{
+		const ExportedImage &image = i->second;
+		if (image.bytes != bytes)
+			continue;
+		if (image.directory == directory)
+			return image.filename;
+		return (directory.empty() ? "" : "../") + (image.directory.empty() ? "" : image.directory + "/") + image.filename;
+	}
+
+	string fullpath = root + "/" + (directory.empty() ? "" : directory + "/") + filename;
+	if (colors)
+		WriteIndexedBMPImage(sprite, width, height, colors, colorCount, fullpath);
+	else
+		WriteBMPImage(sprite, width, height, fullpath);
+
+	ExportedImage &image = exportedImages.insert(make_pair(hash, ExportedImage()))->second;
+	image.directory = directory;
+	image.filename = filename;
+	image.bytes.swap(bytes);
+	return filename;
+}
+
 void ROM::DumpMonsterGraphics(string path)
 {
+	TRACE_SCOPE("rom", "ROM::DumpMonsterGraphics");
 	_mkdir(path.c_str());
+	monsterSpriteFiles.assign(MONSTER_ENTRIES, "");
 
 	//Get all the non-boss monster graphics.
 	unsigned char *sprite;
 	int small = 0; int large = 0;
 	for (int i = 0; i < MONSTER_ENTRIES - 9; i++)
 	{
-		//Find an entry for the monster in one of the battles.
-		int j, k;
-		for (j = 0; j < BATTLE_ENTRIES; j++)
-		{
-			for (k = 0; k < 4; k++)
-				if (battles[j].monsters[k] == i)
-					break;
-			if (k != 4)
-				break;
-		}
-
-		if (j == BATTLE_ENTRIES)
+		//The first battle the monster is in has the graphic.
+		Span<BattleSlot> slots = GetBattlesWithMonster(i);
+		if (slots.empty())
 			continue;
+		int j = slots[0].battle, k = slots[0].slot;
 
 		//Get the graphic for the monster.
 		int palnum = battles[j].monsterPalettes[k];
@@ -413,7 +913,7 @@ void ROM::DumpMonsterGraphics(string path)
 		int size = (picnum == 0 || picnum == 1) ? 32 : 48;
 
 		BuildRGBMonsterSprite(sprite, battles[j].tileset, battles[j].palettes[palnum], battles[j].monsterPics[k]);
-		WriteBMPImage(sprite, size, size, path + "/" + monsters[i].name + ".bmp");
+		monsterSpriteFiles[i] = WriteSharedBMPImage(sprite, size, size, NULL, 0, path, "", monsters[i].name + ".bmp");
 		delete[] sprite;
 	}
 
@@ -454,12 +954,15 @@ TILESET contains 128 MAP TILEs formed from the 128 ROM TILEs available.
 
 void ROM::LoadMapGraphics()
 {
+	TRACE_SCOPE("rom", "ROM::LoadMapGraphics");
 	in.seekg(MAP_PALETTE_OFFSET, ios::beg);
 	in.read((char *)mapPalettes, MAP_PALETTE_ENTRIES*MAP_PALETTE_SIZE);
 	in.seekg(MAP_TILESET_OFFSET, ios::beg);
 	in.read((char *)mapTilesets, MAP_TILESET_ENTRIES*MAP_TILESET_TILE_ENTRIES*MAP_TILE_SIZE);
 	in.seekg(MAP_TILESET_PALETTE_ASSIGNMENT_OFFSET, ios::beg);
 	in.read((char *)mapTilesetPaletteAssignments, MAP_TILESET_ENTRIES*MAP_TILESET_PATTERN_ENTRIES);
+	in.seekg(MAP_TILESET_PROPERTY_OFFSET, ios::beg);
+	in.read((char *)mapTilesetProperties, MAP_TILESET_ENTRIES*MAP_TILESET_PATTERN_ENTRIES*MAP_TILESET_PROPERTY_SIZE);
 	
 	//The tileset patterns are stored kinda funky.
 	//I twiddle them here to make it easier when we actually dump the map graphics.
@@ -541,6 +1044,30 @@ void ROM::BuildRGBMapTileSprite(unsigned char *&sprite, int tileset, int palnum,
 	}
 }
 
+//Like BuildRGBMapTileSprite, but each pixel is left as an index into the map's 16-color palette.
+void ROM::BuildIndexedMapTileSprite(unsigned char *&sprite, int tileset, int tilenum)
+{
+	unsigned char paletteAssignmentData = mapTilesetPaletteAssignments[tileset][tilenum];
+
+	sprite = new unsigned char[16*16];
+	for (int i = 0; i < MAP_TILESET_PATTERN_SIZE; i++)
+	{
+		const unsigned char *tile = mapTilesets[tileset][mapTilesetPatterns[tileset][tilenum][i]];
+		int paletteAssignment = (paletteAssignmentData >> (2*i)) & 3;
+		for (int y = 0; y < 8; y++)
+		{
+			unsigned char temp0 = tile[y];
+			unsigned char temp1 = tile[y+8];
+			for (int x = 7; x >= 0; x--)
+			{
+				int pixel = (temp0 & 1) + ((temp1 & 1)<<1);
+				temp0 >>= 1; temp1 >>= 1;
+				sprite[16*(8*(i/2) + y) + 8*(i%2) + x] = 4*paletteAssignment + pixel;
+			}
+		}
+	}
+}
+
 bool operator ==(const UniqueTileset &lhs, const UniqueTileset &rhs)
 {
 	for (int i = 0; i < MAP_PALETTE_SIZE; i++)
@@ -550,76 +1077,56 @@ bool operator ==(const UniqueTileset &lhs, const UniqueTileset &rhs)
 	return lhs.tileset == rhs.tileset;
 }
 
+/*
+Maps are matched up by a hash of their tileset and palette, so each one is
+looked up once instead of compared with every pair found before it.  Each
+map gets two entries, for its standard and room palettes, and an entry's
+paletteIndex is the first palette with the same colors on the same tileset.
+*/
 vector<UniqueTileset> ROM::FindMapTilesetMappings()
 {
 	vector<UniqueTileset> tilesetMappings;
+	tilesetMappings.reserve(2*MAP_ENTRIES);
+	unordered_map<UniqueTileset, int, UniqueTilesetHash> firstPalettes;
 	
 	//Read in the assignments.
 	unsigned char tilesetAssignments[MAP_ENTRIES];
 	in.seekg(MAP_TILESET_ASSIGNMENT_OFFSET);
 	in.read((char *)tilesetAssignments, MAP_ENTRIES);
 
-	//Find unique tileset/palette combinations.
 	for (int i = 0; i < MAP_ENTRIES; i++)
 	{
-		UniqueTileset curr;
-		curr.tileset = tilesetAssignments[i];
-		for (int j = 0; j < MAP_PALETTE_SIZE; j++)
-			curr.palette[j] = mapPalettes[3*i][j];
-		curr.paletteIndex = 3*i;
-
-		//See if it's already in the list.
-		for (int j = 0; j < tilesetMappings.size(); j++)
+		for (int k = 0; k < 2; k++)
 		{
-			if (curr == tilesetMappings[j])
-			{
-				curr.paletteIndex = tilesetMappings[j].paletteIndex;
-				break;
-			}
+			UniqueTileset curr;
+			curr.tileset = tilesetAssignments[i];
+			curr.paletteIndex = MAP_PALETTES_PER_MAP*i + (k ? PALETTE_ROOM : PALETTE_STANDARD);
+			for (int j = 0; j < MAP_PALETTE_SIZE; j++)
+				curr.palette[j] = mapPalettes[curr.paletteIndex][j];
+
+			//If it's already in the list, point back at the first one.
+			curr.paletteIndex = firstPalettes.insert(make_pair(curr, curr.paletteIndex)).first->second;
+			tilesetMappings.push_back(curr);
 		}
-
-		//Put it in the list.
-		tilesetMappings.push_back(curr);
-
-		//Do it again for the inside-room palette.
-		for (int j = 0; j < MAP_PALETTE_SIZE; j++)
-			curr.palette[j] = mapPalettes[3*i + 2][j];
-		curr.paletteIndex = 3*i + 2;
-
-		//See if it's already in the list.
-		for (int j = 0; j < tilesetMappings.size(); j++)
-		{
-			if (curr == tilesetMappings[j])
-			{
-				curr.paletteIndex = tilesetMappings[j].paletteIndex;
-				break;
-			}
-		}
-
-		//Put it in the list.
-		tilesetMappings.push_back(curr);
 	}
 
 	return tilesetMappings;
 }
 
-vector<UniqueTileset> ROM::FindUniqueMapTilesets(vector<UniqueTileset> tilesetMappings)
+//Mappings with the same tileset and first palette share a unique tileset.  uniqueIndices gets which one each mapping uses.
+vector<UniqueTileset> ROM::FindUniqueMapTilesets(const vector<UniqueTileset> &tilesetMappings, vector<int> &uniqueIndices)
 {
 	vector<UniqueTileset> uniqueTilesets;
-	for (int i = 0; i < tilesetMappings.size(); i++)
+	unordered_map<int, int> found; //by tileset and palette index
+	uniqueIndices.resize(tilesetMappings.size());
+	for (int i = 0; i < (int)tilesetMappings.size(); i++)
 	{
-		UniqueTileset curr = tilesetMappings[i];
-		bool found = false;
-		for (int j = 0; j < i; j++)
-		{
-			if (curr.tileset == tilesetMappings[j].tileset && curr.paletteIndex == tilesetMappings[j].paletteIndex)
-			{
-				found = true;
-				break;
-			}
-		}
-		if (!found)
+		const UniqueTileset &curr = tilesetMappings[i];
+		int key = curr.tileset*MAP_PALETTE_ENTRIES + curr.paletteIndex;
+		pair<unordered_map<int, int>::iterator, bool> entry = found.insert(make_pair(key, (int)uniqueTilesets.size()));
+		if (entry.second)
 			uniqueTilesets.push_back(curr);
+		uniqueIndices[i] = entry.first->second;
 	}
 
 	return uniqueTilesets;
@@ -627,8 +1134,10 @@ vector<UniqueTileset> ROM::FindUniqueMapTilesets(vector<UniqueTileset> tilesetMa
 
 void ROM::DumpMapGraphics(string path)
 {
+	TRACE_SCOPE("rom", "ROM::DumpMapGraphics");
 	vector<UniqueTileset> mappings = FindMapTilesetMappings();
-	vector<UniqueTileset> uniques = FindUniqueMapTilesets(mappings);
+	vector<int> uniqueIndices;
+	vector<UniqueTileset> uniques = FindUniqueMapTilesets(mappings, uniqueIndices);
 
 	_mkdir(path.c_str());
 
@@ -641,17 +1150,17 @@ void ROM::DumpMapGraphics(string path)
 		_mkdir(fullpath.c_str());
 		string tilesetFilename = fullpath + "/" + TILESET_NAMES[tilesetIndex] + ".txt";
 		ofstream tilesetFile(tilesetFilename);
-		tilesetFile << "TileID\tFilename" << endl;
+		tilesetFile << "TileID\tFilename\tProperties" << endl;
 
 		cout << TILESET_NAMES[tilesetIndex] << endl;
 		for (int i = 0; i < MAP_TILESET_PATTERN_ENTRIES; i++)
 		{
 			ostringstream oss;
 			oss << "tile" << setw(3) << setfill('0') << i << ".bmp";
-			tilesetFile << i << "\t" << oss.str() << endl;
-			string tileFilename = fullpath + "/" + oss.str();
+			const unsigned char *props = mapTilesetProperties[uniques[tilesetIndex].tileset][i];
 			BuildRGBMapTileSprite(sprite, uniques[tilesetIndex].tileset, uniques[tilesetIndex].paletteIndex, i);
-			WriteBMPImage(sprite, 16, 16, tileFilename);
+			string tileFilename = WriteSharedBMPImage(sprite, 16, 16, NULL, 0, path, TILESET_NAMES[tilesetIndex], oss.str());
+			tilesetFile << i << "\t" << tileFilename << "\t" << (props[0] | (props[1] << 8)) << endl;
 
 			for (int y = 0; y < 16; y++)
 				for (int x = 0; x < 16; x++)
@@ -663,51 +1172,374 @@ void ROM::DumpMapGraphics(string path)
 		string filename = path + "/" + TILESET_NAMES[tilesetIndex] + ".bmp";
 		WriteBMPImage(bigsprite, 16*16, 16*8, filename);
 	}
+
+	WriteMapTilesetManifest(path + "/" + MAP_TILESET_MANIFEST, uniqueIndices);
+}
+
+//Which of DumpMapGraphics' tilesets each map is drawn with, outside and inside its rooms, so the engine can load just those.
+void ROM::WriteMapTilesetManifest(string filename, const vector<int> &uniqueIndices)
+{
+	ofstream manifest(filename.c_str());
+	manifest << "Map\tTileset\tRoomTileset" << endl;
+	for (int mapIndex = 0; mapIndex < MAP_ENTRIES; mapIndex++)
+	{
+		manifest << MAP_NAMES[mapIndex] << ".map\t";
+		manifest << TILESET_NAMES[uniqueIndices[2*mapIndex]] << "\t";
+		manifest << TILESET_NAMES[uniqueIndices[2*mapIndex + 1]] << endl;
+	}
+	manifest.close();
 }
 
-void ROM::DumpMapData(string path)
+/*
+Indexed tilesets are written once per ROM tileset, with each pixel an index
+into a 16-color map palette, and each map gets a palette file to go with
+them.  The engine looks the colors up when it draws, so a map's inside and
+outside palettes can share one copy of its tiles.
+
+A palette file is the map's tileset number (an int), followed by its
+MAP_PALETTES_PER_MAP palettes of MAP_PALETTE_SIZE RGB colors each.
+*/
+void ROM::DumpIndexedMapGraphics(string path)
 {
+	TRACE_SCOPE("rom", "ROM::DumpIndexedMapGraphics");
 	_mkdir(path.c_str());
 
-	//Get all the pointers to the map locations.
-	unsigned short mapPointers[MAP_ENTRIES];
-	in.seekg(MAP_OFFSET, ios::beg);
-	in.read((char *)mapPointers, MAP_ENTRIES*sizeof(unsigned short));
+	unsigned char tilesetAssignments[MAP_ENTRIES];
+	in.seekg(MAP_TILESET_ASSIGNMENT_OFFSET, ios::beg);
+	in.read((char *)tilesetAssignments, MAP_ENTRIES);
 
+	for (int tileset = 0; tileset < MAP_TILESET_ENTRIES; tileset++)
+	{
+		//The first map on the tileset lends its colors to the BMPs, so they can be looked at.
+		unsigned char colors[MAP_PALETTE_SIZE][3];
+		int palnum = 0;
+		for (int i = 0; i < MAP_ENTRIES; i++)
+		{
+			if (tilesetAssignments[i] == tileset)
+			{
+				palnum = MAP_PALETTES_PER_MAP*i;
+				break;
+			}
+		}
+		for (int i = 0; i < MAP_PALETTE_SIZE; i++)
+			for (int k = 0; k < 3; k++)
+				colors[i][k] = NESpalette[mapPalettes[palnum][i]][k];
+
+		string name = IndexedTilesetName(tileset);
+		string fullpath = path + "/" + name;
+		_mkdir(fullpath.c_str());
+		ofstream tilesetFile((fullpath + "/" + name + ".txt").c_str());
+		tilesetFile << "TileID\tFilename\tProperties" << endl;
+
+		for (int i = 0; i < MAP_TILESET_PATTERN_ENTRIES; i++)
+		{
+			ostringstream oss;
+			oss << "tile" << setw(3) << setfill('0') << i << ".bmp";
+			const unsigned char *props = mapTilesetProperties[tileset][i];
+
+			unsigned char *sprite;
+			BuildIndexedMapTileSprite(sprite, tileset, i);
+			string tileFilename = WriteSharedBMPImage(sprite, 16, 16, colors, MAP_PALETTE_SIZE, path, name, oss.str());
+			tilesetFile << i << "\t" << tileFilename << "\t" << (props[0] | (props[1] << 8)) << endl;
+			delete[] sprite;
+		}
+		tilesetFile.close();
+	}
+
+	_mkdir((path + "/Palettes").c_str());
 	for (int mapIndex = 0; mapIndex < MAP_ENTRIES; mapIndex++)
 	{
-		//Open a file for the map.
-		string filename = path + "/" + MAP_NAMES[mapIndex] + ".map";
-		ofstream mapFile(filename.c_str(), ios::out|ios::binary);
+		string filename = path + "/Palettes/" + MAP_NAMES[mapIndex] + ".pal";
+		ofstream paletteFile(filename.c_str(), ios::out|ios::binary);
+		int tileset = tilesetAssignments[mapIndex];
+		paletteFile.write((char *)&tileset, sizeof(int));
+		for (int i = 0; i < MAP_PALETTES_PER_MAP; i++)
+			for (int j = 0; j < MAP_PALETTE_SIZE; j++)
+				paletteFile.write((char *)NESpalette[mapPalettes[MAP_PALETTES_PER_MAP*mapIndex + i][j]], 3);
+		paletteFile.close();
+	}
+}
 
-		//Seek to the position of the map in the ROM.
-		in.seekg(MAP_OFFSET + (int)mapPointers[mapIndex], ios::beg);
+//All the maps are decoded first, then each file goes out in one write.
+void ROM::DumpMapData(string path)
+{
+	TRACE_SCOPE("rom", "ROM::DumpMapData");
+	_mkdir(path.c_str());
 
-		//Begin decoding the RLE.
-		unsigned char curr = 0;
-		in.get((char&)curr);
-		while (curr != 0xFF)
+	vector<int> tileIDs(MAP_ENTRIES*MAP_WIDTH*MAP_HEIGHT);
+	DecodeAllMaps(&tileIDs[0]);
+	for (int mapIndex = 0; mapIndex < MAP_ENTRIES; mapIndex++)
+		WriteMapFile(path, mapIndex, &tileIDs[mapIndex*MAP_WIDTH*MAP_HEIGHT]);
+}
+
+void ROM::DumpMap(string path, int mapIndex)
+{
+	TRACE_SCOPE("rom", "ROM::DumpMap");
+	vector<int> tileIDs(MAP_WIDTH*MAP_HEIGHT);
+	DecodeMap(mapIndex, &tileIDs[0]);
+	WriteMapFile(path, mapIndex, &tileIDs[0]);
+}
+
+void ROM::WriteMapFile(string path, int mapIndex, const int *tileIDs)
+{
+	string filename = path + "/" + MAP_NAMES[mapIndex] + ".map";
+	ofstream mapFile(filename.c_str(), ios::out|ios::binary);
+	mapFile.write((const char *)tileIDs, MAP_WIDTH*MAP_HEIGHT*sizeof(int));
+	mapFile.close();
+}
+
+void ROM::DecodeMap(int mapIndex, int *tileIDs) const
+{
+	TRACE_SCOPE("rom", "ROM::DecodeMap");
+	//Get the pointer to the map location.  A pointer past the end of the image decodes as all tile 0.
+	size_t pointer = MAP_OFFSET + mapIndex*2;
+	size_t mapPointer = pointer + 1 < image.size() ? image[pointer] | (image[pointer + 1] << 8) : image.size();
+	DecodeMapRLE(MAP_OFFSET + mapPointer, tileIDs, MAP_WIDTH*MAP_HEIGHT);
+}
+
+struct MapDecodeBatch
+{
+	const ROM *rom;
+	const int *mapIndices;
+	int *const *tileIDs;
+	int count;
+	atomic<int> next;
+};
+
+static void MapDecodeWorker(MapDecodeBatch *batch)
+{
+	for (;;)
+	{
+		int index = batch->next++;
+		if (index >= batch->count)
+			break;
+		batch->rom->DecodeMap(batch->mapIndices[index], batch->tileIDs[index]);
+	}
+}
+
+static void MapDecodeThread(MapDecodeBatch *batch)
+{
+	Trace::SetThreadName("Map decoder");
+	MapDecodeWorker(batch);
+}
+
+void ROM::DecodeMaps(const int *mapIndices, int count, int *const *tileIDs, int threadCount) const
+{
+	TRACE_SCOPE("rom", "ROM::DecodeMaps");
+	if (threadCount <= 0)
+		threadCount = thread::hardware_concurrency();
+	if (threadCount > count)
+		threadCount = count;
+	if (threadCount < 1)
+		threadCount = 1;
+
+	MapDecodeBatch batch;
+	batch.rom = this;
+	batch.mapIndices = mapIndices;
+	batch.tileIDs = tileIDs;
+	batch.count = count;
+	batch.next = 0;
+
+	//The calling thread does its share of the work too.
+	vector<thread> workers;
+	for (int i = 1; i < threadCount; i++)
+		workers.push_back(thread(MapDecodeThread, &batch));
+	MapDecodeWorker(&batch);
+	for (int i = 0; i < (int)workers.size(); i++)
+		workers[i].join();
+}
+
+void ROM::DecodeAllMaps(int *tileIDs, int threadCount) const
+{
+	int mapIndices[MAP_ENTRIES];
+	int *buffers[MAP_ENTRIES];
+	for (int i = 0; i < MAP_ENTRIES; i++)
+	{
+		mapIndices[i] = i;
+		buffers[i] = tileIDs + i*MAP_WIDTH*MAP_HEIGHT;
+	}
+	DecodeMaps(mapIndices, MAP_ENTRIES, buffers, threadCount);
+}
+
+void ROM::DecodeOverworld(int *tileIDs) const
+{
+	//Each row is compressed separately, with a pointer in the bank's address space.
+	for (int row = 0; row < OVERWORLD_HEIGHT; row++)
+	{
+		size_t pointer = OVERWORLD_OFFSET + row*2;
+		size_t rowPointer = pointer + 1 < image.size() ? image[pointer] | (image[pointer + 1] << 8) : OVERWORLD_BANK_BASE + image.size();
+		DecodeMapRLE(OVERWORLD_OFFSET + rowPointer - OVERWORLD_BANK_BASE, &tileIDs[row*OVERWORLD_WIDTH], OVERWORLD_WIDTH);
+	}
+}
+
+//Decode the RLE at offset in the image, up to the $FF terminator, into count tiles.
+//Runs are block filled.  Anything the RLE doesn't cover is left as tile 0.
+void ROM::DecodeMapRLE(size_t offset, int *tileIDs, int count) const
+{
+	const unsigned char *data = image.empty() ? NULL : &image[0];
+	size_t size = image.size();
+	int tile = 0;
+	while (offset < size && data[offset] != 0xFF && tile < count)
+	{
+		int curr = data[offset++];
+		int runLength = 1;
+		if (curr & 0x80) //The MSB determines if the next byte is a run length.
 		{
-			int runLength = 1;
-			if (curr & 0x80) //The MSB determines if the next byte is a run length.
-			{
-				curr ^= 0x80; //Remove the MSB.
-				unsigned char temp;
-				in.get((char&)temp);
-				runLength = temp;
-				if (runLength == 0) //0 run length actually means 256.
-					runLength = 256;
-			}
+			if (offset >= size)
+				break;
+			curr ^= 0x80; //Remove the MSB.
+			runLength = data[offset++];
+			if (runLength == 0) //0 run length actually means 256.
+				runLength = 256;
+		}
+
+		//Emit the run.
+		runLength = min(runLength, count - tile);
+		fill_n(tileIDs + tile, runLength, curr);
+		tile += runLength;
+	}
+
+	fill_n(tileIDs + tile, count - tile, 0);
+}
 
-			//Emit the run.
-			int tileID = (int)curr;
-			for (int i = 0; i < runLength; i++)
-				mapFile.write((char *)&tileID, sizeof(int));
+//The overworld is too big for a plain .map, so it goes out as a chunked map.
+void ROM::DumpOverworldData(string filename)
+{
+	TRACE_SCOPE("rom", "ROM::DumpOverworldData");
+	vector<int> tileIDs(OVERWORLD_WIDTH*OVERWORLD_HEIGHT);
+	DecodeOverworld(&tileIDs[0]);
+	ChunkedMap::Write(filename, &tileIDs[0], OVERWORLD_WIDTH, OVERWORLD_HEIGHT);
+}
+
+/*
+Exits come from the tile properties.  On a standard map, a tile marked as a
+teleport takes the player to the map and position at its index in the
+NormTele tables, an exit tile goes to the overworld position in the ExitTele
+tables, and a warp goes back wherever the last teleport came from.  On the
+overworld, tiles with OVERWORLD_PROP_ENTRANCE set in their second property
+byte lead through the EntrTele tables into a standard map.
+*/
+vector<MapExit> ROM::FindMapExits(int mapIndex)
+{
+	vector<MapExit> exits;
+
+	unsigned char tileset;
+	in.seekg(MAP_TILESET_ASSIGNMENT_OFFSET + mapIndex, ios::beg);
+	in.read((char *)&tileset, 1);
+
+	unsigned char teleX[NORM_TELE_ENTRIES], teleY[NORM_TELE_ENTRIES], teleMap[NORM_TELE_ENTRIES];
+	in.seekg(NORM_TELE_OFFSET, ios::beg);
+	in.read((char *)teleX, NORM_TELE_ENTRIES);
+	in.read((char *)teleY, NORM_TELE_ENTRIES);
+	in.read((char *)teleMap, NORM_TELE_ENTRIES);
+
+	unsigned char exitX[EXIT_TELE_ENTRIES], exitY[EXIT_TELE_ENTRIES];
+	in.seekg(EXIT_TELE_OFFSET, ios::beg);
+	in.read((char *)exitX, EXIT_TELE_ENTRIES);
+	in.read((char *)exitY, EXIT_TELE_ENTRIES);
+
+	vector<int> tileIDs(MAP_WIDTH*MAP_HEIGHT);
+	DecodeMap(mapIndex, &tileIDs[0]);
+	for (int i = 0; i < MAP_WIDTH*MAP_HEIGHT; i++)
+	{
+		const unsigned char *props = mapTilesetProperties[tileset][tileIDs[i] % MAP_TILESET_PATTERN_ENTRIES];
+		int teleport = props[0] & TILEPROP_TELEPORT_MASK;
+		if (!teleport)
+			continue;
 
-			in.get((char&)curr);
+		MapExit exit;
+		exit.col = i % MAP_WIDTH;
+		exit.row = i / MAP_WIDTH;
+		exit.destCol = exit.destRow = 0;
+		exit.inRoom = false;
+		int index = props[1];
+		if (teleport == TILEPROP_TELEPORT && index < NORM_TELE_ENTRIES && teleMap[index] < MAP_ENTRIES)
+		{
+			exit.type = EXIT_TELEPORT;
+			exit.destination = string(MAP_NAMES[teleMap[index]]) + ".map";
+			exit.destCol = teleX[index] & TELE_COORD_MASK;
+			exit.destRow = teleY[index] & TELE_COORD_MASK;
+			exit.inRoom = (teleX[index] & TELE_IN_ROOM) != 0;
+		}
+		else if (teleport == TILEPROP_EXIT && index < EXIT_TELE_ENTRIES)
+		{
+			exit.type = EXIT_OVERWORLD;
+			exit.destination = OVERWORLD_FILENAME;
+			exit.destCol = exitX[index];
+			exit.destRow = exitY[index];
 		}
+		else if (teleport == TILEPROP_WARP)
+			exit.type = EXIT_WARP;
+		else
+			continue;
 
-		mapFile.close();
+		exits.push_back(exit);
+	}
+
+	return exits;
+}
+
+vector<MapExit> ROM::FindOverworldExits()
+{
+	vector<MapExit> exits;
+
+	unsigned char props[OVERWORLD_TILE_ENTRIES][MAP_TILESET_PROPERTY_SIZE];
+	in.seekg(OVERWORLD_TILE_PROPERTY_OFFSET, ios::beg);
+	in.read((char *)props, OVERWORLD_TILE_ENTRIES*MAP_TILESET_PROPERTY_SIZE);
+
+	unsigned char entrX[ENTR_TELE_ENTRIES], entrY[ENTR_TELE_ENTRIES], entrMap[ENTR_TELE_ENTRIES];
+	in.seekg(ENTR_TELE_OFFSET, ios::beg);
+	in.read((char *)entrX, ENTR_TELE_ENTRIES);
+	in.read((char *)entrY, ENTR_TELE_ENTRIES);
+	in.read((char *)entrMap, ENTR_TELE_ENTRIES);
+
+	vector<int> tileIDs(OVERWORLD_WIDTH*OVERWORLD_HEIGHT);
+	DecodeOverworld(&tileIDs[0]);
+	for (int i = 0; i < OVERWORLD_WIDTH*OVERWORLD_HEIGHT; i++)
+	{
+		const unsigned char *tileProps = props[tileIDs[i] % OVERWORLD_TILE_ENTRIES];
+		if (!(tileProps[1] & OVERWORLD_PROP_ENTRANCE))
+			continue;
+
+		int index = tileProps[1] & OVERWORLD_PROP_INDEX_MASK;
+		if (index >= ENTR_TELE_ENTRIES || entrMap[index] >= MAP_ENTRIES)
+			continue;
+
+		MapExit exit;
+		exit.col = i % OVERWORLD_WIDTH;
+		exit.row = i / OVERWORLD_WIDTH;
+		exit.type = EXIT_TELEPORT;
+		exit.destination = string(MAP_NAMES[entrMap[index]]) + ".map";
+		exit.destCol = entrX[index] & TELE_COORD_MASK;
+		exit.destRow = entrY[index] & TELE_COORD_MASK;
+		exit.inRoom = (entrX[index] & TELE_IN_ROOM) != 0;
+		exits.push_back(exit);
+	}
+
+	return exits;
+}
+
+void ROM::DumpExitData(string filename)
+{
+	TRACE_SCOPE("rom", "ROM::DumpExitData");
+	ofstream out(filename.c_str());
+	out << "Map\tX\tY\tType\tDestination\tDestX\tDestY\tInRoom" << endl;
+
+	for (int mapIndex = -1; mapIndex < MAP_ENTRIES; mapIndex++)
+	{
+		string mapFilename = mapIndex < 0 ? OVERWORLD_FILENAME : string(MAP_NAMES[mapIndex]) + ".map";
+		vector<MapExit> exits = mapIndex < 0 ? FindOverworldExits() : FindMapExits(mapIndex);
+		for (int i = 0; i < (int)exits.size(); i++)
+		{
+			out << mapFilename << '\t';
+			out << exits[i].col << '\t';
+			out << exits[i].row << '\t';
+			out << MapExits::TypeName(exits[i].type) << '\t';
+			out << exits[i].destination << '\t';
+			out << exits[i].destCol << '\t';
+			out << exits[i].destRow << '\t';
+			out << (exits[i].inRoom ? 1 : 0) << endl;
+		}
 	}
 }
 
@@ -723,54 +1555,159 @@ mucking about with palettes and tile patterns here.
 
 void ROM::LoadTextTables(string stdFilename, string DTEFilename)
 {
-	ifstream tables;
+	TRACE_SCOPE("rom", "ROM::LoadTextTables");
+	text.LoadTables(stdFilename, DTEFilename);
+}
 
-	tables.open(stdFilename.c_str());
-	while (!tables.eof())
+//Decode every name in the ROM in one pass, into one pool.
+void ROM::LoadNames()
+{
+	TRACE_SCOPE("rom", "ROM::LoadNames");
+	vector<int> monsterIndices, weaponIndices, armorIndices;
+	DecodeNames(MONSTER_TEXT_PTR_TABLE_OFFSET, MONSTER_TEXT_BASE, MONSTER_ENTRIES, monsterIndices);
+	DecodeNames(WEAPON_TEXT_PTR_TABLE_OFFSET, WEAPON_TEXT_BASE, WEAPON_ENTRIES, weaponIndices);
+	DecodeNames(ARMOR_TEXT_PTR_TABLE_OFFSET, ARMOR_TEXT_BASE, ARMOR_ENTRIES, armorIndices);
+
+	//The pool is done growing, so the names can point into it now.
+	for (int i = 0; i < (int)monsterIndices.size(); i++)
+		monsterNames.push_back(text.Get(monsterIndices[i]));
+	for (int i = 0; i < (int)weaponIndices.size(); i++)
+		weaponNames.push_back(text.Get(weaponIndices[i]));
+	for (int i = 0; i < (int)armorIndices.size(); i++)
+		armorNames.push_back(text.Get(armorIndices[i]));
+}
+
+//Each entry of a text pointer table is a little-endian offset from textBase.
+void ROM::DecodeNames(int pointerTable, int textBase, int count, vector<int> &names)
+{
+	for (int i = 0; i < count; i++)
 	{
-		char val[2];
-		int index;
-		val[1] = tables.get();
-		val[0] = tables.get();
-		if (val[0] >= '0' && val[0] <= '9')
-			index = val[0] - '0';
-		else
-			index = val[0] - 'A' + 10;
-		if (val[1] >= '0' && val[1] <= '9')
-			index += (val[1] - '0')*16;
-		else
-			index += (val[1] - 'A' + 10)*16;
-		tables.get(); //remove the '=' character
-		if (!tables.eof())
-			getline(tables, textTable[index]);
+		size_t entry = pointerTable + i*2;
+		int pointer = entry + 1 < image.size() ? image[entry] + 256*image[entry + 1] : 0;
+		names.push_back(text.Decode(image.empty() ? NULL : &image[0], image.size(), textBase + pointer));
 	}
-	tables.close();
+}
 
-	tables.open(DTEFilename.c_str());
-	while (!tables.eof())
+/*
+The reverse indexes are built from (key, entry) pairs gathered in table
+order, so each span lists its battles, maps or items in the order the
+tables have them.  An item's spell byte is the spell's index plus one, with
+0 for none.
+*/
+void ROM::BuildIndexes()
+{
+	TRACE_SCOPE("rom", "ROM::BuildIndexes");
+	vector<pair<int, BattleSlot> > battlePairs;
+	for (int i = 0; i < (int)battles.size(); i++)
 	{
-		char val[2];
-		int index;
-		val[1] = tables.get();
-		val[0] = tables.get();
-		if (val[0] >= '0' && val[0] <= '9')
-			index = val[0] - '0';
-		else
-			index = val[0] - 'A' + 10;
-		if (val[1] >= '0' && val[1] <= '9')
-			index += (val[1] - '0')*16;
-		else
-			index += (val[1] - 'A' + 10)*16;
-		tables.get(); //remove the '=' character
-		if (!tables.eof())
-			getline(tables, DTETable[index]);
+		for (int k = 0; k < 4; k++)
+		{
+			BattleSlot slot = { (unsigned char)i, (unsigned char)k };
+			if (battles[i].monsters[k] >= 0 && battles[i].monsters[k] < MONSTER_ENTRIES)
+				battlePairs.push_back(make_pair(battles[i].monsters[k], slot));
+		}
+	}
+	battlesByMonster.Build(MONSTER_ENTRIES, battlePairs);
+
+	//Maps share graphics when they have the same tileset and standard palette, hashed as in FindMapTilesetMappings.
+	unsigned char tilesetAssignments[MAP_ENTRIES] = { 0 };
+	for (int i = 0; i < MAP_ENTRIES && MAP_TILESET_ASSIGNMENT_OFFSET + i < (int)image.size(); i++)
+		tilesetAssignments[i] = image[MAP_TILESET_ASSIGNMENT_OFFSET + i];
+
+	vector<pair<int, unsigned char> > tilesetPairs, graphicsPairs;
+	unordered_map<UniqueTileset, int, UniqueTilesetHash> firstMaps;
+	for (int i = 0; i < MAP_ENTRIES; i++)
+	{
+		UniqueTileset key;
+		key.tileset = tilesetAssignments[i];
+		memcpy(key.palette, mapPalettes[MAP_PALETTES_PER_MAP*i], MAP_PALETTE_SIZE);
+		key.paletteIndex = MAP_PALETTES_PER_MAP*i;
+		int first = firstMaps.insert(make_pair(key, i)).first->second;
+
+		mapGraphics[i] = first;
+		if (tilesetAssignments[i] < MAP_TILESET_ENTRIES)
+			tilesetPairs.push_back(make_pair((int)tilesetAssignments[i], (unsigned char)i));
+		graphicsPairs.push_back(make_pair(first, (unsigned char)i));
+	}
+	mapsByTileset.Build(MAP_TILESET_ENTRIES, tilesetPairs);
+	mapsByGraphics.Build(MAP_ENTRIES, graphicsPairs);
+
+	vector<pair<int, unsigned char> > spellPairs;
+	for (int i = 0; i < (int)monsters.size(); i++)
+	{
+		for (int j = 0; j < 8; j++)
+		{
+			int spell = monsters[i].spells[j];
+			bool repeat = false;
+			for (int k = 0; k < j; k++)
+				repeat |= monsters[i].spells[k] == spell;
+			if (spell >= 0 && spell < SPELL_ENTRIES && !repeat)
+				spellPairs.push_back(make_pair(spell, (unsigned char)i));
+		}
+	}
+	monstersBySpell.Build(SPELL_ENTRIES, spellPairs);
+
+	spellPairs.clear();
+	for (int i = 0; i < (int)weapons.size(); i++)
+		if (weapons[i].spell > 0 && weapons[i].spell <= SPELL_ENTRIES)
+			spellPairs.push_back(make_pair(weapons[i].spell - 1, (unsigned char)i));
+	weaponsBySpell.Build(SPELL_ENTRIES, spellPairs);
+
+	spellPairs.clear();
+	for (int i = 0; i < (int)armor.size(); i++)
+		if (armor[i].spell > 0 && armor[i].spell <= SPELL_ENTRIES)
+			spellPairs.push_back(make_pair(armor[i].spell - 1, (unsigned char)i));
+	armorBySpell.Build(SPELL_ENTRIES, spellPairs);
+}
+
+Span<unsigned char> ROM::GetMapsWithGraphics(int mapIndex) const
+{
+	if (mapIndex < 0 || mapIndex >= MAP_ENTRIES)
+		return mapsByGraphics.Get(-1);
+	return mapsByGraphics.Get(mapGraphics[mapIndex]);
+}
+
+/*
+An AI table entry in the NES ROM consists of:
+byte 0: Chance out of 128 that the monster casts a spell on its turn.
+byte 1: Chance out of 128 that the monster uses a special ability instead.
+byte 2-9: 8 indices into the spell table, cast in order.  0xFF = empty.
+byte 10: Unused (always 0xFF).
+byte 11-14: 4 indices into the ability table, used in order.  0xFF = empty.
+byte 15: Unused (always 0xFF).
+*/
+
+//Read the AI scripts from the ROM.
+vector<AIScript> ROM::LoadAIScripts()
+{
+	TRACE_SCOPE("rom", "ROM::LoadAIScripts");
+	vector<AIScript> scriptList;
+	unsigned char data[AI_ENTRIES][AI_SIZE];
+
+	in.seekg(AI_OFFSET, ios::beg);
+	in.read((char *)data, AI_ENTRIES*AI_SIZE);
+
+	for (int i = 0; i < AI_ENTRIES; i++)
+	{
+		AIScript script;
+		script.magChance = data[i][0];
+		script.abilChance = data[i][1];
+		for (int j = 0; j < 8; j++)
+			script.spells[j] = (data[i][2 + j] == 0xFF) ? -1 : data[i][2 + j];
+		for (int j = 0; j < 4; j++)
+			script.abilities[j] = (data[i][11 + j] == 0xFF) ? -1 : data[i][11 + j];
+
+		scriptList.push_back(script);
 	}
-	tables.close();
+
+	return scriptList;
 }
 
 //Read the monster data from the ROM.
+//Load the AI scripts first!
 vector<Monster> ROM::LoadMonsters()
 {
+	TRACE_SCOPE("rom", "ROM::LoadMonsters");
 	vector<Monster> monsterList;
 	unsigned char data[MONSTER_ENTRIES][MONSTER_SIZE];
 	
@@ -778,11 +1715,6 @@ vector<Monster> ROM::LoadMonsters()
 	in.seekg(MONSTER_OFFSET, ios::beg);
 	in.read((char *)data, MONSTER_ENTRIES*MONSTER_SIZE);
 
-	//Read the monster text pointers table.
-	unsigned short monTextPointers[MONSTER_ENTRIES];
-	in.seekg(MONSTER_TEXT_PTR_TABLE_OFFSET, ios::beg);
-	in.read((char *)monTextPointers, MONSTER_ENTRIES*sizeof(short));
-
 	//Initialize the monsters.
 	for (int i = 0; i < MONSTER_ENTRIES; i++)
 	{
@@ -804,6 +1736,23 @@ vector<Monster> ROM::LoadMonsters()
 		monster.initiative = data[i][17];
 		monster.magdef = 0;
 
+		//Copy in the monster's AI script, if it has one.
+		monster.magChance = monster.abilChance = 0;
+		for (int j = 0; j < 8; j++)
+			monster.spells[j] = -1;
+		for (int j = 0; j < 4; j++)
+			monster.abilities[j] = -1;
+		if (monster.aiScript < (int)aiScripts.size())
+		{
+			const AIScript &script = aiScripts[monster.aiScript];
+			monster.magChance = script.magChance;
+			monster.abilChance = script.abilChance;
+			for (int j = 0; j < 8; j++)
+				monster.spells[j] = script.spells[j];
+			for (int j = 0; j < 4; j++)
+				monster.abilities[j] = script.abilities[j];
+		}
+
 		//Weaknesses and resistances are more complicated.
 		monster.elemWeak = data[i][18];
 		monster.elemRes = data[i][19];
@@ -817,15 +1766,8 @@ vector<Monster> ROM::LoadMonsters()
 				monster.elemMod[j] = 0;
 		}
 
-		//Finally, lookup the name in the ROM.
-		monster.name = "";
-		int offset = MONSTER_TEXT_BASE + monTextPointers[i];
-		in.seekg(offset, ios::beg);
-		while (in.peek() != 0)
-		{
-			int temp = in.get();
-			monster.name += textTable[temp];
-		}
+		//Finally, the name, which was decoded along with all the others.
+		monster.name = monsterNames[i].ToString();
 
 		//Add the initialized monster to the list.
 		monsterList.push_back(monster);
@@ -837,6 +1779,7 @@ vector<Monster> ROM::LoadMonsters()
 //Read the weapons data from the ROM.
 vector<Weapon> ROM::LoadWeapons()
 {
+	TRACE_SCOPE("rom", "ROM::LoadWeapons");
 	vector<Weapon> weaponList;
 	unsigned char data[WEAPON_ENTRIES][WEAPON_SIZE];
 	unsigned short prices[WEAPON_ENTRIES];
@@ -850,11 +1793,6 @@ vector<Weapon> ROM::LoadWeapons()
 	in.seekg(WEAPON_PERMS_OFFSET, ios::beg);
 	in.read((char *)perms, 2*WEAPON_ENTRIES);
 
-	//Read the weapon text pointers table.
-	unsigned short weaponTextPointers[WEAPON_ENTRIES];
-	in.seekg(WEAPON_TEXT_PTR_TABLE_OFFSET, ios::beg);
-	in.read((char *)weaponTextPointers, WEAPON_ENTRIES*sizeof(short));
-
 	//Initialize the weapons.
 	for (int i = 0; i < WEAPON_ENTRIES; i++)
 	{
@@ -870,15 +1808,8 @@ vector<Weapon> ROM::LoadWeapons()
 		weapon.price = prices[i];
 		weapon.equipMask = (~perms[i]) & 0x0FFF; //we only want the low-order 12 bits, negated
 
-		//Finally, lookup the name in the ROM.
-		weapon.name = "";
-		int offset = WEAPON_TEXT_BASE + weaponTextPointers[i];
-		in.seekg(offset, ios::beg);
-		while (in.peek() != 0)
-		{
-			int temp = in.get();
-			weapon.name += textTable[temp];
-		}
+		//Finally, the name, which was decoded along with all the others.
+		weapon.name = weaponNames[i].ToString();
 
 		//Add the initialized weapon to the list.
 		weaponList.push_back(weapon);
@@ -890,6 +1821,7 @@ vector<Weapon> ROM::LoadWeapons()
 //Read the armor data from the ROM.
 vector<Armor> ROM::LoadArmor()
 {
+	TRACE_SCOPE("rom", "ROM::LoadArmor");
 	vector<Armor> armorList;
 	unsigned char data[ARMOR_ENTRIES][ARMOR_SIZE];
 	unsigned short prices[ARMOR_ENTRIES];
@@ -903,11 +1835,6 @@ vector<Armor> ROM::LoadArmor()
 	in.seekg(ARMOR_PERMS_OFFSET, ios::beg);
 	in.read((char *)perms, 2*ARMOR_ENTRIES);
 
-	//Read the armor text pointers table.
-	unsigned short armorTextPointers[ARMOR_ENTRIES];
-	in.seekg(ARMOR_TEXT_PTR_TABLE_OFFSET, ios::beg);
-	in.read((char *)armorTextPointers, ARMOR_ENTRIES*sizeof(short));
-
 	//Initialize the armor.
 	for (int i = 0; i < ARMOR_ENTRIES; i++)
 	{
@@ -936,15 +1863,8 @@ vector<Armor> ROM::LoadArmor()
 		else
 			armor.wearloc = (1<<WEAR_GLOVE);
 
-		//Finally, lookup the name in the ROM.
-		armor.name = "";
-		int offset = ARMOR_TEXT_BASE + armorTextPointers[i];
-		in.seekg(offset, ios::beg);
-		while (in.peek() != 0)
-		{
-			int temp = in.get();
-			armor.name += textTable[temp];
-		}
+		//Finally, the name, which was decoded along with all the others.
+		armor.name = armorNames[i].ToString();
 
 		//Add the initialized armor to the list.
 		armorList.push_back(armor);
@@ -956,6 +1876,7 @@ vector<Armor> ROM::LoadArmor()
 //Read the spell table from the ROM.
 vector<Spell> ROM::LoadSpells()
 {
+	TRACE_SCOPE("rom", "ROM::LoadSpells");
 	vector<Spell> spellList;
 	unsigned char spells[SPELL_ENTRIES][SPELL_SIZE];
 	unsigned short prices[SPELL_ENTRIES];
@@ -1009,6 +1930,18 @@ vector<Spell> ROM::LoadSpells()
 	return spellList;
 }
 
+//Read the random number table from the ROM.  Pass it to a TableRNG to get the game's exact rolls.
+vector<unsigned char> ROM::LoadRNGTable()
+{
+	TRACE_SCOPE("rom", "ROM::LoadRNGTable");
+	vector<unsigned char> table(RNG_TABLE_SIZE);
+
+	in.seekg(RNG_TABLE_OFFSET, ios::beg);
+	in.read((char *)&table[0], RNG_TABLE_SIZE);
+
+	return table;
+}
+
 
 
 /****************************************************
@@ -1018,6 +1951,7 @@ vector<Spell> ROM::LoadSpells()
 
 void ROM::DumpMonsterData(string filename)
 {
+	TRACE_SCOPE("rom", "ROM::DumpMonsterData");
 	ofstream out(filename.c_str());
 	out << "MonsterID\tName\tHP\tAttX\tAtt\tAcc\tCrit\tDef\tAgi\tMDef\tInit\tExp\tGold\t"
 		<< "Morale\tType\tAttElem\tAttStat\tElemRes\tElemWeak\tAI\tSprite" << endl;
@@ -1044,12 +1978,16 @@ void ROM::DumpMonsterData(string filename)
 		out << monsters[i].elemRes << '\t';
 		out << monsters[i].elemWeak << '\t';
 		out << monsters[i].aiScript << '\t';
-		out << monsters[i].name << ".bmp" << endl;
+		if (i < (int)monsterSpriteFiles.size() && !monsterSpriteFiles[i].empty())
+			out << monsterSpriteFiles[i] << endl;
+		else
+			out << monsters[i].name << ".bmp" << endl;
 	}
 }
 
 void ROM::DumpWeaponData(string filename)
 {
+	TRACE_SCOPE("rom", "ROM::DumpWeaponData");
 	ofstream out(filename.c_str());
 	out << "WeaponID\tName\tPrice\tPower\tAcc\tCrit\tElem\tStat\tType\tEquip\tWear\tSpell" << endl;
 
@@ -1072,6 +2010,7 @@ void ROM::DumpWeaponData(string filename)
 
 void ROM::DumpArmorData(string filename)
 {
+	TRACE_SCOPE("rom", "ROM::DumpArmorData");
 	ofstream out(filename.c_str());
 	out << "ArmorID\tName\tPrice\tDef\tWeight\tElem\tEquip\tWear\tSpell" << endl;
 
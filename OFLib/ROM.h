@@ -15,19 +15,42 @@
 #include "../OFLib/Items.h"
 #include "../OFLib/Magic.h"
 #include "../OFLib/BattleDef.h"
+#include "../OFLib/BattleScene.h"
+#include "../OFLib/Random.h"
+#include "../OFLib/ChunkedMap.h"
+#include "../OFLib/MapExits.h"
+#include "../OFLib/Defs.h"
+#include "../OFLib/Palette.h"
+#include "../OFLib/TextDecoder.h"
+#include "../OFLib/Hash.h"
+#include "../OFLib/ReverseIndex.h"
 
 #include <fstream>
 #include <vector>
 #include <string>
+#include <map>
 using namespace std;
 
 const string QUEST_ROOT = "../Quests/FF1";
+const string OVERWORLD_FILENAME = "Overworld.map";
+const string EXPORT_MANIFEST = "Export.manifest";
+
+const string STANDARD_TABLE_FILE = "StandardTable.tbl";
+const string DTE_TABLE_FILE = "DTETable.tbl";
+const string NES_PALETTE_FILE = "FFHackster.pal";
+
+#define EXPORT_MANIFEST_VERSION 1 //bump whenever the exporter's output changes, to force a full export
 
 //Data table definitions.
 #define MONSTER_OFFSET 0x30530
 #define MONSTER_SIZE 20
 #define MONSTER_ENTRIES 128
 
+#define AI_OFFSET 0x31030
+#define AI_SIZE 16
+#define AI_ENTRIES 44
+#define AI_NONE 0xFF //monsters with this script only ever attack
+
 #define WEAPON_OFFSET 0x30010
 #define WEAPON_PERMS_OFFSET 0x3BF60
 #define WEAPON_PRICE_OFFSET 0x37C48
@@ -79,13 +102,36 @@ const string QUEST_ROOT = "../Quests/FF1";
 #define MAP_TILESET_ASSIGNMENT_OFFSET 0x2CD0
 #define MAP_ENTRIES 61
 #define MAP_PALETTE_OFFSET 0x2010
-#define MAP_PALETTE_ENTRIES MAP_ENTRIES*3 //Each map has three palettes: standard, inside-room, and sprites+controls.
+#define MAP_PALETTES_PER_MAP 3
+#define MAP_PALETTE_ENTRIES MAP_ENTRIES*MAP_PALETTES_PER_MAP //Each map has three palettes: standard, inside-room, and sprites+controls.
 #define MAP_PALETTE_SIZE 16
 #define MAP_TILESET_PATTERN_OFFSET 0x1010
 #define MAP_TILESET_PATTERN_ENTRIES 128
 #define MAP_TILESET_PATTERN_SIZE 4
 #define MAP_TILESET_PALETTE_ASSIGNMENT_OFFSET 0x410
+#define MAP_TILESET_PROPERTY_OFFSET 0x810
+#define MAP_TILESET_PROPERTY_SIZE 2 //TILEPROP_* flags, then a teleport/treasure/battle index
 #define MAP_OFFSET 0x10010 //The first 128 bytes are 2-byte pointers to the maps based from this offset.
+#define OVERWORLD_OFFSET 0x4010 //One 2-byte pointer per row, in the bank's address space, then the rows.
+#define OVERWORLD_BANK_BASE 0x8000
+#define OVERWORLD_WIDTH 256
+#define OVERWORLD_HEIGHT 256
+#define OVERWORLD_TILE_PROPERTY_OFFSET 0x10 //MAP_TILESET_PROPERTY_SIZE bytes per tile
+#define OVERWORLD_TILE_ENTRIES 128
+#define OVERWORLD_PROP_ENTRANCE 0x80 //in the second byte, with the EntrTele index under it
+#define OVERWORLD_PROP_INDEX_MASK 0x3F
+#define MAP_WIDTH 64
+#define MAP_HEIGHT 64
+
+//Teleport tables: all the x coordinates, then all the y's, then the destination maps.
+#define NORM_TELE_OFFSET 0x2D10 //standard map to standard map
+#define NORM_TELE_ENTRIES 64
+#define ENTR_TELE_OFFSET 0x2C10 //overworld to standard map
+#define ENTR_TELE_ENTRIES 32
+#define EXIT_TELE_OFFSET 0x2C70 //standard map to overworld, no map table
+#define EXIT_TELE_ENTRIES 16
+#define TELE_COORD_MASK 0x3F
+#define TELE_IN_ROOM 0x80 //in the x coordinate
 
 #define NES_PALETTE_ENTRIES 64
 
@@ -98,6 +144,8 @@ const string QUEST_ROOT = "../Quests/FF1";
 #define ARMOR_TEXT_PTR_TABLE_OFFSET 0x2B798
 #define ARMOR_TEXT_BASE 0x20010
 
+#define RNG_TABLE_OFFSET 0x3F110 //RNG_TABLE_SIZE shuffled bytes behind every random roll in the game
+
 
 
 enum MonsterPic
@@ -117,6 +165,31 @@ struct UniqueTileset
 	int paletteIndex;
 };
 
+//Hashes what operator== compares: the tileset and the palette's colors, not where the palette came from.
+struct UniqueTilesetHash
+{
+	size_t operator()(const UniqueTileset &key) const
+	{
+		return (size_t)HashBytes(key.palette, MAP_PALETTE_SIZE, HashBytes(&key.tileset, sizeof(key.tileset)));
+	}
+};
+
+bool operator ==(const UniqueTileset &lhs, const UniqueTileset &rhs);
+
+//Where a monster appears: a battle, and which of its four groups.
+struct BattleSlot
+{
+	unsigned char battle, slot;
+};
+
+//Where an exported image went, so identical images can point at it instead of being written again.
+struct ExportedImage
+{
+	string directory; //relative to the export root it was written under
+	string filename;
+	vector<unsigned char> bytes; //everything that was hashed, since two different images can hash the same
+};
+
 
 
 //The actual workhorse.
@@ -124,25 +197,47 @@ class ROM
 {
 public:
 
-	ROM(string filename);
+	ROM(string filename, string dataPath = "."); //dataPath holds the text tables and NES palette
 	~ROM();
 
 	void ExportFull();
+	void ExportIncremental(); //only what changed since the last export
 
 	void LoadTextTables(string stdFilename, string DTEFilename);
+	void LoadNames();
 	void LoadNESPalette(string filename);
 
 	void LoadBattleGraphics();
 	void LoadMapGraphics();
 
+	//Pack the graphics a battle's enemies use into one atlas, ready for a BattleScene.
+	void BuildBattleAtlas(const BattleDef &def, BattleAtlas &atlas);
+
+	//Decode one map tile or monster picture as BGR.  The sprite is allocated with new[], and the caller deletes it.
+	void BuildRGBMapTileSprite(unsigned char *&sprite, int tileset, int palnum, int tilenum);
+	void BuildRGBMonsterSprite(unsigned char *&sprite, int tileset, int palnum, int picnum);
+
+	/* Reverse indexes over the tables, built once when the ROM is loaded.  The
+	   spans point into the ROM, so they're good for as long as it is, and list
+	   their entries in table order. */
+	Span<BattleSlot> GetBattlesWithMonster(int monster) const { return battlesByMonster.Get(monster); }
+	Span<unsigned char> GetMapsWithTileset(int tileset) const { return mapsByTileset.Get(tileset); }
+	Span<unsigned char> GetMapsWithGraphics(int mapIndex) const; //the maps with the same tileset and palette, mapIndex included
+	Span<unsigned char> GetMonstersWithSpell(int spell) const { return monstersBySpell.Get(spell); }
+	Span<unsigned char> GetWeaponsWithSpell(int spell) const { return weaponsBySpell.Get(spell); }
+	Span<unsigned char> GetArmorWithSpell(int spell) const { return armorBySpell.Get(spell); }
+
+	vector<AIScript> LoadAIScripts();
 	vector<Monster> LoadMonsters();
 	vector<BattleDef> LoadBattles();
 	vector<Weapon> LoadWeapons();
 	vector<Armor> LoadArmor();
 	vector<Spell> LoadSpells();
+	vector<unsigned char> LoadRNGTable();
 
 	void DumpMonsterGraphics(string path);
 	void DumpMapGraphics(string path);
+	void DumpIndexedMapGraphics(string path);
 
 	void DumpMonsterData(string filename);
 	void DumpWeaponData(string filename);
@@ -150,19 +245,53 @@ public:
 	void DumpSpellData(string filename);
 
 	void DumpMapData(string path);
+	void DumpMap(string path, int mapIndex);
+	void DumpOverworldData(string filename);
+	void DumpExitData(string filename);
+
+	/* Map decoding works from the ROM image in memory, so it never touches the
+	   disk and is safe to call from several threads at once.  Each map fills
+	   MAP_WIDTH*MAP_HEIGHT ints of the caller's buffer, from the top row down. */
+	void DecodeMap(int mapIndex, int *tileIDs) const;
+	void DecodeMaps(const int *mapIndices, int count, int *const *tileIDs, int threadCount = 0) const; //spread across threads (0 = one per core)
+	void DecodeAllMaps(int *tileIDs, int threadCount = 0) const; //all MAP_ENTRIES maps, back to back in one buffer
+	void DecodeOverworld(int *tileIDs) const; //OVERWORLD_WIDTH*OVERWORLD_HEIGHT ints
+
+	static void WriteBMPImage(unsigned char *sprite, int width, int height, string filename);
+	static void WriteIndexedBMPImage(unsigned char *sprite, int width, int height, const unsigned char (*colors)[3], int colorCount, string filename);
 
 private:
 
-	void BuildRGBMapTileSprite(unsigned char *&sprite, int tileset, int palnum, int tilenum);
-	void BuildRGBMonsterSprite(unsigned char *&sprite, int tileset, int palnum, int picnum);
+	void BuildIndexedMapTileSprite(unsigned char *&sprite, int tileset, int tilenum);
 	void BuildRGBBossSprite(unsigned char *&sprite, int tileset, int palnum1, int palnum2, MonsterPic monpic);
+	void BuildRGBAMonsterSprite(unsigned char *rgba, int pitch, int tileset, int palnum, int picnum);
 
-	void WriteBMPImage(unsigned char *sprite, int width, int height, string filename);
+	string WriteSharedBMPImage(unsigned char *sprite, int width, int height, const unsigned char (*colors)[3], int colorCount,
+		string root, string directory, string filename);
+
+	void DecodeMapRLE(size_t offset, int *tileIDs, int count) const;
+	static void WriteMapFile(string path, int mapIndex, const int *tileIDs);
+	vector<MapExit> FindMapExits(int mapIndex);
+	vector<MapExit> FindOverworldExits();
 
 	vector<UniqueTileset> FindMapTilesetMappings();
-	vector<UniqueTileset> FindUniqueMapTilesets(vector<UniqueTileset> tilesetMappings);
+	vector<UniqueTileset> FindUniqueMapTilesets(const vector<UniqueTileset> &tilesetMappings, vector<int> &uniqueIndices);
+	static void WriteMapTilesetManifest(string filename, const vector<int> &uniqueIndices);
+
+	void DecodeNames(int pointerTable, int textBase, int count, vector<int> &names);
+	void BuildIndexes();
+
+	map<string, unsigned long long> FindSectionChecksums();
+	map<string, vector<string> > FindSectionOutputs();
+	static bool FileExists(string filename);
+	unsigned long long HashRegion(int offset, int size, unsigned long long hash = FNV_OFFSET_BASIS);
+	unsigned long long HashNames(const vector<StringRef> &names, unsigned long long hash = FNV_OFFSET_BASIS);
+	map<string, unsigned long long> ReadExportManifest(string filename);
+	void WriteExportManifest(string filename, const map<string, unsigned long long> &checksums);
 	
 	ifstream in;
+	string dataPath;
+	vector<unsigned char> image; //the whole ROM, for anything that hops around it a byte at a time
 
 	unsigned char NESpalette[NES_PALETTE_ENTRIES][3];
 	
@@ -173,15 +302,26 @@ private:
 	unsigned char mapTilesets[MAP_TILESET_ENTRIES][MAP_TILESET_TILE_ENTRIES][MAP_TILE_SIZE];
 	unsigned char mapTilesetPatterns[MAP_TILESET_ENTRIES][MAP_TILESET_PATTERN_ENTRIES][MAP_TILESET_PATTERN_SIZE];
 	unsigned char mapTilesetPaletteAssignments[MAP_TILESET_ENTRIES][MAP_TILESET_PATTERN_ENTRIES];
+	unsigned char mapTilesetProperties[MAP_TILESET_ENTRIES][MAP_TILESET_PATTERN_ENTRIES][MAP_TILESET_PROPERTY_SIZE];
 
+	vector<AIScript> aiScripts;
 	vector<Monster> monsters;
 	vector<BattleDef> battles;
 	vector<Weapon> weapons;
 	vector<Armor> armor;
 	vector<Spell> spells;
 
-	string textTable[256];
-	string DTETable[256];
+	TextDecoder text;
+	vector<StringRef> monsterNames, weaponNames, armorNames;
+
+	ReverseIndex<BattleSlot> battlesByMonster;
+	ReverseIndex<unsigned char> mapsByTileset;
+	ReverseIndex<unsigned char> mapsByGraphics; //keyed by the first map with each tileset and palette
+	ReverseIndex<unsigned char> monstersBySpell, weaponsBySpell, armorBySpell;
+	unsigned char mapGraphics[MAP_ENTRIES]; //each map's key in mapsByGraphics
+
+	multimap<unsigned long long, ExportedImage> exportedImages; //by a hash of the pixels and colors
+	vector<string> monsterSpriteFiles; //as written by DumpMonsterGraphics, empty where there wasn't one
 };
 
 
@@ -0,0 +1,41 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "Random.h"
+
+TableRNG::TableRNG(const unsigned char *table, int index)
+{
+	for (int i = 0; i < RNG_TABLE_SIZE; i++)
+		this->table[i] = table[i];
+	this->index = index & 0xFF;
+}
+
+
+
+CounterRNG::CounterRNG(unsigned long long seed, unsigned long long stream)
+{
+	this->seed = seed;
+	//Mix the stream in twice so neighboring streams don't share any outputs.
+	key = Mix(Mix(seed) ^ Mix(stream + 0x632BE59BD9B4E019ULL));
+	counter = 0;
+}
+
+void CounterRNG::Fill(unsigned int *out, int count)
+{
+	unsigned long long base = counter;
+	for (int i = 0; i < count; i++)
+		out[i] = (unsigned int)(Hash(key, base + i) >> 32);
+	counter += count;
+}
+
+void CounterRNG::FillRange(int *out, int count, int lo, int hi)
+{
+	unsigned long long base = counter;
+	unsigned int range = (unsigned int)(hi - lo + 1);
+	for (int i = 0; i < count; i++)
+		out[i] = lo + (int)(((Hash(key, base + i) >> 32)*range) >> 32);
+	counter += count;
+}
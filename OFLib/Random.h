@@ -0,0 +1,97 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* Random.h
+* Defines the random number generators used by battle and encounter
+* simulation: an exact copy of the game's table-driven generator, and a fast
+* seedable generator for everything that doesn't need to match the NES.
+*****************************************************************************/
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#define RNG_TABLE_SIZE 256
+
+/* The NES game has no real random number generator.  It keeps a one-byte
+   index into a table of 256 shuffled bytes, and every call advances the
+   index and returns the next byte in the table.  The sequence repeats every
+   256 calls, so the index is the entire state.  Load the table from the ROM
+   (see ROM::LoadRNGTable) to reproduce the game's rolls exactly. */
+class TableRNG
+{
+public:
+
+	TableRNG(const unsigned char *table, int index = 0);
+
+	int Next() { index = (index + 1) & 0xFF; return table[index]; }
+
+	//The game's RandAX routine: a value from lo to hi inclusive, scaled from one table byte.
+	int Range(int lo, int hi) { return lo + ((Next()*(hi - lo + 1)) >> 8); }
+
+	int GetIndex() { return index; }
+	void SetIndex(int index) { this->index = index & 0xFF; }
+
+private:
+
+	unsigned char table[RNG_TABLE_SIZE];
+	int index;
+};
+
+
+
+/* A counter-based generator.  Each output is a hash of the key and a 64-bit
+   counter, so any position in the sequence can be computed directly.  That
+   makes jumping ahead free, and lets every thread or simulation run its own
+   stream from the same seed without sharing state.  The same seed and stream
+   always produce the same sequence on every platform. */
+class CounterRNG
+{
+public:
+
+	CounterRNG(unsigned long long seed = 0, unsigned long long stream = 0);
+
+	unsigned long long Next64() { return Hash(key, counter++); }
+	unsigned int Next() { return (unsigned int)(Next64() >> 32); }
+
+	//A value from lo to hi inclusive.  Uses a multiply instead of a modulo, so there are no divides.
+	int Range(int lo, int hi) { return lo + (int)(((unsigned long long)Next()*(unsigned int)(hi - lo + 1)) >> 32); }
+
+	//Returns true with the given percent chance (0-100).
+	bool Percent(int chance) { return Range(0, 99) < chance; }
+
+	//Skip the next count numbers.
+	void Jump(unsigned long long count) { counter += count; }
+
+	//An independent generator for another thread or simulation, derived from the same seed.
+	CounterRNG Stream(unsigned long long stream) const { return CounterRNG(seed, stream); }
+
+	//Generate many values at once.  Each slot depends only on its counter,
+	//so the compiler is free to vectorize these loops.
+	void Fill(unsigned int *out, int count);
+	void FillRange(int *out, int count, int lo, int hi);
+
+	unsigned long long GetCounter() { return counter; }
+	void SetCounter(unsigned long long counter) { this->counter = counter; }
+
+private:
+
+	static unsigned long long Mix(unsigned long long x)
+	{
+		x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ULL;
+		x ^= x >> 27; x *= 0x94D049BB133111EBULL;
+		x ^= x >> 31;
+		return x;
+	}
+
+	static unsigned long long Hash(unsigned long long key, unsigned long long counter)
+	{
+		return Mix(key + counter*0x9E3779B97F4A7C15ULL);
+	}
+
+	unsigned long long seed, key;
+	unsigned long long counter;
+};
+
+#endif
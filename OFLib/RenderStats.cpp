@@ -0,0 +1,9 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "RenderStats.h"
+
+RenderStats renderStats = { 0, 0, 0, 0 };
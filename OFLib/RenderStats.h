@@ -0,0 +1,31 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* RenderStats.h
+* Defines the counters the drawing code keeps of its GL work each frame, for
+* the engine's performance overlay.
+*****************************************************************************/
+
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+#include <cstddef>
+
+/* Only the thread with the GL context touches these, so they're plain
+   counters: added to right where the GL calls are made, and reset by the
+   game loop at the start of each frame. */
+struct RenderStats
+{
+	int drawCalls; //glBegin batches, counting the ones run from display lists
+	int textureBinds;
+	int tilesDrawn;
+	size_t uploadedBytes; //texture data handed to the driver
+
+	void Reset() { drawCalls = textureBinds = tilesDrawn = 0; uploadedBytes = 0; }
+};
+
+extern RenderStats renderStats;
+
+#endif
@@ -0,0 +1,79 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* ReverseIndex.h
+* Defines a compact one-to-many index, for looking up everything that refers
+* to a table entry without scanning the tables that refer to it.
+*****************************************************************************/
+
+#ifndef REVERSEINDEX_H
+#define REVERSEINDEX_H
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+using namespace std;
+
+//A read-only run of entries.  Only good as long as the index it came from.
+template <class T>
+struct Span
+{
+	const T *data;
+	int count;
+
+	const T *begin() const { return data; }
+	const T *end() const { return data + count; }
+	int size() const { return count; }
+	bool empty() const { return count == 0; }
+	const T &operator[](int i) const { return data[i]; }
+};
+
+/* Compressed sparse rows: every key's entries back to back in one array,
+   with offsets[key] where they start and offsets[key + 1] where they end.
+   A lookup is two loads and no search, and there's one allocation for all
+   the entries, however many keys there are. */
+template <class T>
+class ReverseIndex
+{
+public:
+
+	ReverseIndex() : offsets(1, 0) {}
+
+	//Built from (key, entry) pairs in two passes: count each key, then place.  Each key's entries keep the order they were given in.
+	void Build(int keyCount, const vector<pair<int, T> > &pairs)
+	{
+		offsets.assign(keyCount + 1, 0);
+		for (int i = 0; i < (int)pairs.size(); i++)
+			offsets[pairs[i].first + 1]++;
+		for (int key = 0; key < keyCount; key++)
+			offsets[key + 1] += offsets[key];
+
+		entries.resize(pairs.size());
+		vector<int> next(offsets.begin(), offsets.end() - 1);
+		for (int i = 0; i < (int)pairs.size(); i++)
+			entries[next[pairs[i].first]++] = pairs[i].second;
+	}
+
+	//Keys out of range have no entries.
+	Span<T> Get(int key) const
+	{
+		Span<T> span = { NULL, 0 };
+		if (key >= 0 && key + 1 < (int)offsets.size() && offsets[key + 1] > offsets[key])
+		{
+			span.data = &entries[offsets[key]];
+			span.count = offsets[key + 1] - offsets[key];
+		}
+		return span;
+	}
+
+	int GetKeyCount() const { return offsets.size() - 1; }
+
+private:
+
+	vector<int> offsets; //one more than there are keys
+	vector<T> entries;
+};
+
+#endif
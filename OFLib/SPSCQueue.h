@@ -0,0 +1,61 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* SPSCQueue.h
+* Defines a fixed-size queue that one thread can push onto while another
+* pops off of it, without either one taking a lock.
+*****************************************************************************/
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <vector>
+#include <atomic>
+using namespace std;
+
+/* head is only written by the consumer and tail only by the producer.  Each
+   side publishes its index with a release store after it's done with the
+   slot, and reads the other's with an acquire load, so an item is always
+   completely written before it can be popped.  One slot is left empty to
+   tell a full queue from an empty one. */
+template <class T>
+class SPSCQueue
+{
+public:
+
+	SPSCQueue(int capacity) : items(capacity + 1), head(0), tail(0) {}
+
+	//Producer only.  Returns false if the queue is full.
+	bool Push(const T &item)
+	{
+		int t = tail.load(memory_order_relaxed);
+		int next = (t + 1 == (int)items.size()) ? 0 : t + 1;
+		if (next == head.load(memory_order_acquire))
+			return false;
+		items[t] = item;
+		tail.store(next, memory_order_release);
+		return true;
+	}
+
+	//Consumer only.  Returns false if the queue is empty.
+	bool Pop(T &item)
+	{
+		int h = head.load(memory_order_relaxed);
+		if (h == tail.load(memory_order_acquire))
+			return false;
+		item = items[h];
+		head.store((h + 1 == (int)items.size()) ? 0 : h + 1, memory_order_release);
+		return true;
+	}
+
+private:
+
+	vector<T> items;
+	atomic<int> head;
+	char padding[64]; //keeps the two indices off each other's cache line
+	atomic<int> tail;
+};
+
+#endif
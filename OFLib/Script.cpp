@@ -1,5 +1,12 @@
 #include "Script.h"
 #include "Expression.h"
+#include "Trace.h"
+
+int ScriptManager::Evaluate(Expression *expression)
+{
+	TRACE_SCOPE("script", "ScriptManager::Evaluate");
+	return expression->Evaluate();
+}
 
 Expression *ScriptManager::BuildExpression(ifstream &in)
 {
@@ -11,6 +11,7 @@ class ScriptManager
 public:
 	int GetVarValue(string varName) { return 0; }
 	Expression *BuildExpression(ifstream &in);
+	int Evaluate(Expression *expression); //the same as expression->Evaluate(), but shows up in a trace
 };
 
 class ExprParseException
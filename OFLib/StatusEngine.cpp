@@ -0,0 +1,125 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "StatusEngine.h"
+
+StatusEngine::StatusEngine(int capacity)
+{
+	rules.poisonDivisor = 16;
+	rules.poisonMin = 1;
+	rules.sleepWakeChance = 25;
+	rules.stunWakeChance = 25;
+
+	if (capacity < 1)
+		capacity = 1;
+
+	count = 0;
+	hp.resize(capacity);
+	hpMax.resize(capacity);
+	status.resize(capacity);
+	poisonDamage.resize(capacity);
+	rolls.resize(2*capacity);
+}
+
+int StatusEngine::Add(int hp, int hpMax, int status)
+{
+	//Only grows if more combatants are added than the engine was built for.
+	if (count == (int)this->hp.size())
+	{
+		this->hp.resize(2*count);
+		this->hpMax.resize(2*count);
+		this->status.resize(2*count);
+		poisonDamage.resize(2*count);
+		rolls.resize(4*count);
+	}
+
+	int damage = hpMax/rules.poisonDivisor;
+	if (damage < rules.poisonMin)
+		damage = rules.poisonMin;
+
+	this->hp[count] = hp;
+	this->hpMax[count] = hpMax;
+	this->status[count] = status;
+	poisonDamage[count] = damage;
+	return count++;
+}
+
+int StatusEngine::AddParty(const Ally *party, int partySize)
+{
+	int first = count;
+	for (int i = 0; i < partySize; i++)
+		Add(party[i].hp, party[i].hpMax, party[i].status);
+	return first;
+}
+
+int StatusEngine::AddEnemies(const Battle &battle, const BattlePool &pool)
+{
+	int first = count;
+	for (int i = 0; i < battle.enemyCount; i++)
+		Add(battle.enemies[i].hp, pool.GetMonster(battle.enemies[i]).hpMax, battle.enemies[i].status);
+	return first;
+}
+
+void StatusEngine::StoreParty(Ally *party, int partySize, int first) const
+{
+	for (int i = 0; i < partySize; i++)
+	{
+		party[i].hp = hp[first + i];
+		party[i].status = status[first + i];
+	}
+}
+
+void StatusEngine::StoreEnemies(Battle &battle, int first) const
+{
+	for (int i = 0; i < battle.enemyCount; i++)
+	{
+		battle.enemies[i].hp = hp[first + i];
+		battle.enemies[i].status = status[first + i];
+	}
+}
+
+
+
+void StatusEngine::ApplyPoison()
+{
+	int *hp = &this->hp[0], *status = &this->status[0];
+	const int *damage = &poisonDamage[0];
+
+	for (int i = 0; i < count; i++)
+	{
+		//1 if poisoned and still standing, 0 otherwise.
+		int poisoned = (status[i] >> STAT_POISON) & 1;
+		int standing = (status[i] & STATMASK_INCAPACITATED) == 0;
+
+		int newHP = hp[i] - damage[i]*(poisoned & standing);
+		newHP = newHP < 0 ? 0 : newHP;
+		hp[i] = newHP;
+		status[i] |= (newHP == 0) << STAT_DEATH;
+	}
+}
+
+void StatusEngine::RollRecovery(CounterRNG &rng)
+{
+	//Roll for everyone at once, whether they need it or not.
+	int *sleepRolls = &rolls[0], *stunRolls = &rolls[count];
+	rng.FillRange(sleepRolls, 2*count, 0, 99);
+
+	int *status = &this->status[0];
+	int sleepChance = rules.sleepWakeChance, stunChance = rules.stunWakeChance;
+	for (int i = 0; i < count; i++)
+	{
+		int wakeSleep = sleepRolls[i] < sleepChance;
+		int wakeStun = stunRolls[i] < stunChance;
+		status[i] &= ~((wakeSleep << STAT_SLEEP) | (wakeStun << STAT_STUN));
+	}
+}
+
+void StatusEngine::CanAct(unsigned char *canAct) const
+{
+	const int *status = &this->status[0];
+	for (int i = 0; i < count; i++)
+		canAct[i] = (status[i] & STATMASK_NO_ACTION) == 0;
+}
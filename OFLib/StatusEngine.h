@@ -0,0 +1,84 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* StatusEngine.h
+* Defines the per-turn processing of status effects for everyone in a fight.
+*****************************************************************************/
+
+#ifndef STATUSENGINE_H
+#define STATUSENGINE_H
+
+#include "Defs.h"
+#include "Items.h"
+#include "Magic.h"
+#include "Character.h"
+#include "Battle.h"
+#include "Random.h"
+#include <vector>
+using namespace std;
+
+#define MAX_COMBATANTS (4 + MAX_ENEMIES)
+
+//Status bits, as stored in Ally::status and Enemy::status.
+#define STATMASK(stat) (1<<(stat))
+#define STATMASK_INCAPACITATED (STATMASK(STAT_DEATH)|STATMASK(STAT_STONE))
+#define STATMASK_NO_ACTION (STATMASK_INCAPACITATED|STATMASK(STAT_SLEEP)|STATMASK(STAT_STUN))
+
+//Tunable numbers for status effects.  Chances are out of 100.
+struct StatusRules
+{
+	int poisonDivisor; //poison takes maxHP/poisonDivisor each turn...
+	int poisonMin; //...but never less than this
+	int sleepWakeChance;
+	int stunWakeChance;
+};
+
+/* Everyone's HP and status live in parallel arrays, party first, so each
+   effect is one pass over the whole fight.  The passes are written without
+   branches on the status bits, which lets the compiler vectorize them and
+   keeps the cost the same no matter how the statuses are spread around.
+   Several fights can share one engine by adding all of their combatants. */
+class StatusEngine
+{
+public:
+
+	StatusEngine(int capacity = MAX_COMBATANTS);
+
+	//Set the rules before adding combatants.
+	void SetRules(const StatusRules &rules) { this->rules = rules; }
+
+	//Add combatants, returning the slot of the first one added.
+	int Add(int hp, int hpMax, int status);
+	int AddParty(const Ally *party, int partySize);
+	int AddEnemies(const Battle &battle, const BattlePool &pool);
+	void Clear() { count = 0; }
+
+	//Copy the results back out.
+	void StoreParty(Ally *party, int partySize, int first) const;
+	void StoreEnemies(Battle &battle, int first) const;
+
+	//End-of-turn effects.  Poison can kill, and the dead are marked.
+	void ApplyPoison();
+	void RollRecovery(CounterRNG &rng);
+	void EndTurn(CounterRNG &rng) { ApplyPoison(); RollRecovery(rng); }
+
+	//Fill canAct with 1 for each combatant able to take a turn, 0 otherwise.
+	void CanAct(unsigned char *canAct) const;
+
+	int Count() const { return count; }
+	int GetHP(int slot) const { return hp[slot]; }
+	int GetStatus(int slot) const { return status[slot]; }
+	void SetStatus(int slot, int status) { this->status[slot] = status; }
+
+private:
+
+	StatusRules rules;
+	int count;
+	vector<int> hp, hpMax, status;
+	vector<int> poisonDamage; //worked out once when each combatant is added
+	vector<int> rolls; //scratch space for the recovery rolls
+};
+
+#endif
@@ -0,0 +1,97 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "TextDecoder.h"
+#include <fstream>
+#include <cstring>
+using namespace std;
+
+TextDecoder::TextDecoder()
+{
+	memset(entries, 0, sizeof(entries));
+	memset(entryLengths, 0, sizeof(entryLengths));
+}
+
+bool TextDecoder::LoadTables(string stdFilename, string DTEFilename)
+{
+	bool loaded = LoadTable(stdFilename, true);
+	return LoadTable(DTEFilename, false) && loaded;
+}
+
+static int HexDigit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return -1;
+}
+
+//Read the whole file at once and pick the lines apart in memory.
+bool TextDecoder::LoadTable(string filename, bool overwrite)
+{
+	ifstream table(filename.c_str(), ios::in|ios::binary);
+	if (!table)
+		return false;
+	table.seekg(0, ios::end);
+	size_t size = (size_t)table.tellg();
+	table.seekg(0, ios::beg);
+	vector<char> text(size);
+	if (size > 0)
+		table.read(&text[0], size);
+
+	size_t pos = 0;
+	while (pos < size)
+	{
+		size_t end = pos;
+		while (end < size && text[end] != '\n')
+			end++;
+		size_t lineEnd = end;
+		if (lineEnd > pos && text[lineEnd - 1] == '\r')
+			lineEnd--;
+
+		if (lineEnd - pos >= 3 && text[pos + 2] == '=')
+		{
+			int high = HexDigit(text[pos]), low = HexDigit(text[pos + 1]);
+			if (high >= 0 && low >= 0)
+			{
+				int index = high*16 + low;
+				if (overwrite || entryLengths[index] == 0)
+				{
+					size_t length = lineEnd - (pos + 3);
+					if (length > TEXT_ENTRY_MAX)
+						length = TEXT_ENTRY_MAX;
+					memcpy(entries[index], &text[pos + 3], length);
+					entryLengths[index] = (unsigned char)length;
+				}
+			}
+		}
+		pos = end + 1;
+	}
+	return true;
+}
+
+int TextDecoder::Decode(const unsigned char *rom, size_t romSize, size_t offset)
+{
+	PoolString decoded;
+	decoded.start = pool.size();
+	for (size_t i = offset; i < romSize && rom[i] != 0; i++)
+		pool.insert(pool.end(), entries[rom[i]], entries[rom[i]] + entryLengths[rom[i]]);
+	decoded.length = pool.size() - decoded.start;
+
+	strings.push_back(decoded);
+	return strings.size() - 1;
+}
+
+StringRef TextDecoder::Get(int index) const
+{
+	StringRef ref;
+	ref.data = pool.empty() ? "" : &pool[0] + strings[index].start;
+	ref.length = strings[index].length;
+	return ref;
+}
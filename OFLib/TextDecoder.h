@@ -0,0 +1,71 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* TextDecoder.h
+* Defines a decoder for the ROM's text encoding, which turns every string it
+* is given into one shared pool.
+*****************************************************************************/
+
+#ifndef TEXTDECODER_H
+#define TEXTDECODER_H
+
+#include <string>
+#include <vector>
+using namespace std;
+
+#define TEXT_TABLE_ENTRIES 256
+#define TEXT_ENTRY_MAX 4 //longest expansion of one byte; the longest in the tables is 2
+
+//A piece of a string pool.  Not zero-terminated.
+struct StringRef
+{
+	const char *data;
+	size_t length;
+
+	string ToString() const { return string(data, length); }
+	bool operator==(const string &other) const { return other.compare(0, string::npos, data, length) == 0; }
+};
+
+/*
+A table file is one entry per line, as used by most ROM hacking tools:
+XX=text
+where XX is the byte in hex.  The standard table covers the letters and item
+icons used in names.  The DTE (dual tile encoding) table adds the bytes that
+stand for two letters at once in dialogue, like 1C=th.  Both are merged into
+one lookup, with the standard table winning where they overlap.
+*/
+
+class TextDecoder
+{
+public:
+
+	TextDecoder();
+
+	//Returns false if either table couldn't be read.
+	bool LoadTables(string stdFilename, string DTEFilename);
+
+	/* Decode the zero-terminated string at offset in the ROM into the pool,
+	   and return its index.  StringRefs from Get point into the pool, so they
+	   only stay good until the next Decode; decode everything first. */
+	int Decode(const unsigned char *rom, size_t romSize, size_t offset);
+	StringRef Get(int index) const;
+	int GetCount() const { return strings.size(); }
+
+private:
+
+	bool LoadTable(string filename, bool overwrite);
+
+	char entries[TEXT_TABLE_ENTRIES][TEXT_ENTRY_MAX];
+	unsigned char entryLengths[TEXT_TABLE_ENTRIES];
+
+	struct PoolString
+	{
+		size_t start, length;
+	};
+	vector<char> pool;
+	vector<PoolString> strings;
+};
+
+#endif
@@ -0,0 +1,133 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "TileWindow.h"
+#include "RenderStats.h"
+#include <SDL/SDL_opengl.h>
+using namespace std;
+
+TileWindow::TileWindow(int cols, int rows)
+{
+	this->cols = cols;
+	this->rows = rows;
+	left = bottom = 0;
+	firstCol = firstRow = 0;
+	valid = false;
+
+	exposed.reserve(cols*rows);
+	listBase = glGenLists(cols*rows);
+	lists.resize(cols*rows);
+	for (int i = 0; i < cols*rows; i++)
+		lists[i] = i;
+}
+
+TileWindow::~TileWindow()
+{
+	glDeleteLists(listBase, cols*rows);
+}
+
+void TileWindow::MoveTo(int left, int bottom)
+{
+	exposed.clear();
+
+	int dx = left - this->left, dy = bottom - this->bottom;
+	if (!valid || dx >= cols || -dx >= cols || dy >= rows || -dy >= rows)
+	{
+		//Too far to scroll, so start over.
+		this->left = left;
+		this->bottom = bottom;
+		firstCol = firstRow = 0;
+		for (int col = 0; col < cols; col++)
+			ExposeColumn(col, left + col);
+		valid = true;
+		return;
+	}
+
+	//The column leaving one side comes back in on the other.
+	while (this->left < left)
+	{
+		ExposeColumn(firstCol, this->left + cols);
+		firstCol = (firstCol + 1 == cols) ? 0 : firstCol + 1;
+		this->left++;
+	}
+	while (this->left > left)
+	{
+		firstCol = (firstCol == 0) ? cols - 1 : firstCol - 1;
+		this->left--;
+		ExposeColumn(firstCol, this->left);
+	}
+
+	//Same for rows.  A corner cell can be exposed twice; the last one is right.
+	while (this->bottom < bottom)
+	{
+		ExposeRow(firstRow, this->bottom + rows);
+		firstRow = (firstRow + 1 == rows) ? 0 : firstRow + 1;
+		this->bottom++;
+	}
+	while (this->bottom > bottom)
+	{
+		firstRow = (firstRow == 0) ? rows - 1 : firstRow - 1;
+		this->bottom--;
+		ExposeRow(firstRow, this->bottom);
+	}
+}
+
+void TileWindow::ExposeColumn(int col, int x)
+{
+	for (int j = 0; j < rows; j++)
+	{
+		int row = firstRow + j;
+		if (row >= rows)
+			row -= rows;
+
+		WindowCell cell = { x, bottom + j, row*cols + col };
+		exposed.push_back(cell);
+	}
+}
+
+void TileWindow::ExposeRow(int row, int y)
+{
+	for (int i = 0; i < cols; i++)
+	{
+		int col = firstCol + i;
+		if (col >= cols)
+			col -= cols;
+
+		WindowCell cell = { left + i, y, row*cols + col };
+		exposed.push_back(cell);
+	}
+}
+
+void TileWindow::Set(const WindowCell &cell, unsigned int texture)
+{
+	int x = cell.x, y = cell.y;
+
+	glNewList(listBase + cell.cell, GL_COMPILE);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glBegin(GL_QUADS);
+			glTexCoord2i(0, 0);
+			glVertex2i(x, y);
+			glTexCoord2i(0, 1);
+			glVertex2i(x, y + 1);
+			glTexCoord2i(1, 1);
+			glVertex2i(x + 1, y + 1);
+			glTexCoord2i(1, 0);
+			glVertex2i(x + 1, y);
+		glEnd();
+	glEndList();
+}
+
+void TileWindow::Draw() const
+{
+	//Every cell's list binds its tile's texture and draws one quad.
+	renderStats.drawCalls += lists.size();
+	renderStats.textureBinds += lists.size();
+	renderStats.tilesDrawn += lists.size();
+
+	glListBase(listBase);
+	glCallLists(lists.size(), GL_UNSIGNED_INT, &lists[0]);
+	glListBase(0);
+}
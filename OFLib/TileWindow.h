@@ -0,0 +1,66 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* TileWindow.h
+* Defines the window of map tiles around the camera, which is kept up to date
+* a row or column at a time as the camera scrolls.
+*****************************************************************************/
+
+#ifndef TILEWINDOW_H
+#define TILEWINDOW_H
+
+#include <vector>
+using namespace std;
+
+//A cell that has scrolled into view and needs a tile.
+struct WindowCell
+{
+	int x, y; //world coordinates
+	int cell; //where it is in the window
+};
+
+/* The window is a ring buffer in both directions.  When the camera moves,
+   the row or column that scrolls off one side is reused for the one coming
+   into view on the other, so a scroll step only touches the tiles along one
+   edge of the screen.  Everything else stays where it is.
+
+   Each cell has its own display list holding its texture and quad, in world
+   coordinates, and the whole window is drawn with a single glCallLists. */
+class TileWindow
+{
+public:
+
+	TileWindow(int cols, int rows);
+	~TileWindow();
+
+	//Move the window so its lower left tile is at (left, bottom).
+	//The cells that came into view are listed in GetExposed() until the next move.
+	void MoveTo(int left, int bottom);
+	const vector<WindowCell> &GetExposed() const { return exposed; }
+
+	//Give an exposed cell its tile.
+	void Set(const WindowCell &cell, unsigned int texture);
+
+	//Expose every cell on the next move, e.g. after the tiles or the map change.
+	void Invalidate() { valid = false; }
+
+	void Draw() const;
+
+private:
+
+	void ExposeColumn(int col, int x);
+	void ExposeRow(int row, int y);
+
+	int cols, rows;
+	int left, bottom;
+	int firstCol, firstRow; //the cell at (left, bottom)
+	bool valid;
+
+	vector<WindowCell> exposed;
+	unsigned int listBase;
+	vector<unsigned int> lists; //0 through cols*rows - 1, offset from listBase
+};
+
+#endif
@@ -2,42 +2,130 @@
 #include <sstream>
 #include "Tileset.h"
 #include "FlatFile.h"
+#include "RenderStats.h"
+#include "MemoryTracker.h"
+#include "Trace.h"
 using namespace std;
 
 Tileset::Tileset(string path)
 {
-	const string TILESET_ROOT = "../Quests/FF1/Graphics/Maps";
+	TRACE_SCOPE("assets", "Tileset::Tileset");
+	vector<TileImage> images;
+	Decode(path, images);
 
+	name = path;
+	textureCount = 0;
+	byteSize = 0;
+	indexed = false;
+	for (int i = 0; i < (int)images.size(); i++)
+	{
+		Upload(images[i]);
+		FreeImage(images[i]);
+	}
+	complete = true;
+}
+
+Tileset::Tileset()
+{
+	textureCount = 0;
+	byteSize = 0;
+	indexed = false;
+	complete = false;
+}
+
+Tileset::~Tileset()
+{
+	for (map<int, unsigned int>::iterator i = textures.begin(); i != textures.end(); i++)
+		glDeleteTextures(1, &i->second);
+	MemoryTracker::Get().Free(MEMORY_TILESETS, MEMORY_GPU, name, byteSize);
+}
+
+void Tileset::Decode(string path, vector<TileImage> &images)
+{
+	TRACE_SCOPE("assets", "Tileset::Decode");
 	FlatFileReader tilesetFile(TILESET_ROOT + "/" + path + "/" + path + ".txt");
-	textureCount = tilesetFile.lines.size();
-	unsigned int *textureArray = new unsigned int[textureCount];
-	glGenTextures(textureCount, textureArray);
-	int textureIndex = 0;
+	bool hasProperties = tilesetFile.headers.count("Properties") != 0; //older exports don't have these
 	for (lineIterator line = tilesetFile.lines.begin(); line != tilesetFile.lines.end(); line++)
 	{
+		TileImage image;
 		string tileFilename = (*line)[tilesetFile.headers["Filename"]];
 		string tileIDString = (*line)[tilesetFile.headers["TileID"]];
 		
 		istringstream tileIDOSS(tileIDString);
-		int tileID;
-		tileIDOSS >> tileID;
-		textures[tileID] = textureArray[textureIndex];
+		tileIDOSS >> image.tileID;
 
-		int width, height;
-		unsigned char *image = LoadBMPImage(TILESET_ROOT + "/" + path + "/" + tileFilename, width, height);
+		image.properties = 0;
+		if (hasProperties)
+		{
+			istringstream propertiesISS((*line)[tilesetFile.headers["Properties"]]);
+			propertiesISS >> image.properties;
+		}
 
-		glBindTexture(GL_TEXTURE_2D, textures[textureIndex]);
+		image.pixels = LoadBMPImage(TILESET_ROOT + "/" + path + "/" + tileFilename, image.width, image.height, image.channels);
+		MemoryTracker::Get().Allocate(MEMORY_LOADING, MEMORY_CPU, "Decoded tiles", image.width*image.height*image.channels);
+		images.push_back(image);
+	}
+}
+
+vector<string> Tileset::GetFiles(string path)
+{
+	vector<string> files(1, TILESET_ROOT + "/" + path + "/" + path + ".txt");
+	FlatFileReader tilesetFile(files[0]);
+	for (lineIterator line = tilesetFile.lines.begin(); line != tilesetFile.lines.end(); line++)
+		files.push_back(TILESET_ROOT + "/" + path + "/" + (*line)[tilesetFile.headers["Filename"]]);
+	return files;
+}
+
+void Tileset::ReadSource()
+{
+	source.files = GetFiles(name);
+	ReadFileSource(source);
+}
+
+void Tileset::FreeImage(TileImage &image)
+{
+	if (!image.pixels)
+		return;
+	MemoryTracker::Get().Free(MEMORY_LOADING, MEMORY_CPU, "Decoded tiles", image.width*image.height*image.channels);
+	delete[] image.pixels;
+	image.pixels = NULL;
+}
+
+void Tileset::Upload(const TileImage &image)
+{
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	textures[image.tileID] = texture;
+	properties[image.tileID] = image.properties;
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	renderStats.textureBinds++;
+	renderStats.uploadedBytes += image.width*image.height*image.channels;
+	size_t bytes;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	if (image.channels == 1)
+	{
+		//Indices can't be blended or mipmapped, only looked up.
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, image.width, image.height, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, image.pixels);
+		bytes = MemoryTracker::TextureBytes(image.width, image.height, 1, false);
+		indexed = true;
+	}
+	else
+	{
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, image);
-
-		delete[] image;
-
-		textureIndex++;
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, image.width, image.height, 0, GL_BGR, GL_UNSIGNED_BYTE, image.pixels);
+		bytes = MemoryTracker::TextureBytes(image.width, image.height, 4, true); //the driver pads to 32 bits
 	}
+
+	byteSize += bytes;
+	MemoryTracker::Get().Allocate(MEMORY_TILESETS, MEMORY_GPU, name, bytes);
+	textureCount++;
 }
 
 unsigned int Tileset::operator [](int tileID)
@@ -45,7 +133,14 @@ unsigned int Tileset::operator [](int tileID)
 	return textures[tileID];
 }
 
-unsigned char *Tileset::LoadBMPImage(string filename, int &width, int &height)
+int Tileset::GetProperties(int tileID) const
+{
+	map<int, int>::const_iterator prop = properties.find(tileID);
+	return prop == properties.end() ? 0 : prop->second;
+}
+
+//Reads 24-bit BMPs as BGR, and 8-bit BMPs as the raw indices.
+unsigned char *Tileset::LoadBMPImage(string filename, int &width, int &height, int &channels)
 {
 	ifstream bmpFile(filename.c_str(), ios::in|ios::binary);
 	
@@ -56,10 +151,21 @@ unsigned char *Tileset::LoadBMPImage(string filename, int &width, int &height)
 	bmpFile.seekg(18, ios::beg);
 	bmpFile.read((char *)&width, sizeof(int));
 	bmpFile.read((char *)&height, sizeof(int));
+	bmpFile.seekg(28, ios::beg);
+	short bitsPerPixel = 24;
+	bmpFile.read((char *)&bitsPerPixel, sizeof(short));
+	channels = (bitsPerPixel == 8) ? 1 : 3;
 
-	unsigned char *pixels = new unsigned char[width*height*3];
+	//Rows are padded to 4 bytes.
+	int rowSize = width*channels;
+	int paddedRowSize = (rowSize + 3) & ~3;
+	unsigned char *pixels = new unsigned char[rowSize*height];
 	bmpFile.seekg(pixelOffset, ios::beg);
-	bmpFile.read((char *)pixels, width*height*3);
+	for (int row = 0; row < height; row++)
+	{
+		bmpFile.read((char *)&pixels[row*rowSize], rowSize);
+		bmpFile.seekg(paddedRowSize - rowSize, ios::cur);
+	}
 
 	return pixels;
 }
\ No newline at end of file
@@ -2,23 +2,69 @@
 #define TILESET_H
 
 #include <map>
+#include <vector>
+#include <string>
+#include "Hash.h"
 using namespace std;
 
+const string TILESET_ROOT = "../Quests/FF1/Graphics/Maps";
+const string MAP_TILESET_MANIFEST = "Map Tilesets.txt"; //under TILESET_ROOT, which RGB tilesets each map uses
+
+//One tile read from disk, waiting to be uploaded.
+struct TileImage
+{
+	int tileID;
+	int properties;
+	int width, height;
+	int channels; //3 for BGR, 1 for palette indices
+	unsigned char *pixels; //owned by whoever holds the image
+};
+
 class Tileset
 {
 public:
 	
 	Tileset(string path);
+	Tileset(); //empty, to be filled in a tile at a time with Upload
+	~Tileset();
+
+	//What the tileset's memory is counted under.  Set by the constructor that loads it, or by whoever fills in an empty one.
+	void SetName(string name) { this->name = name; }
+	string GetName() const { return name; }
+
+	//Read and decode every tile in a tileset.  Doesn't touch GL, so it can run on any thread.
+	static void Decode(string path, vector<TileImage> &images);
+	static void FreeImage(TileImage &image); //once it's uploaded, or not needed
+	static vector<string> GetFiles(string path); //the index and every tile it lists
+
+	//Note which files the tileset came from and what they held.  Whoever loads it calls this, on any thread.
+	void ReadSource();
+	FileSource &GetSource() { return source; }
+
+	//Make a texture for one decoded tile.  Has to run on the thread with the GL context.
+	void Upload(const TileImage &image);
+	void MarkComplete() { complete = true; }
+	bool IsComplete() const { return complete; }
+	bool IsIndexed() const { return indexed; } //needs a Palette and the PaletteShader to draw
+
+	size_t GetByteSize() const { return byteSize; } //of the uploaded textures
 
 	unsigned int operator [](int tileID);
+	int GetProperties(int tileID) const; //TILEPROP_* flags in the low byte, index in the high byte
 
 	int textureCount;
 
 private:
 
-	unsigned char *LoadBMPImage(string filename, int &width, int &height);
+	static unsigned char *LoadBMPImage(string filename, int &width, int &height, int &channels);
 
 	map<int, unsigned int> textures;
+	map<int, int> properties;
+	string name;
+	FileSource source;
+	bool complete; //every tile has been uploaded
+	bool indexed;
+	size_t byteSize;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,182 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "Trace.h"
+#include "Platform.h"
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <mutex>
+#include <chrono>
+using namespace std;
+
+struct TraceEvent
+{
+	const char *category;
+	const char *name;
+	long long time; //nanoseconds since the clock was started
+	char phase; //'B' or 'E'
+};
+
+/* Only the thread that owns a buffer writes to it.  It fills in an event,
+   allocating the chunk first if it's the chunk's first, and then publishes
+   it with a release store of count, so anything that reads count with an
+   acquire sees whole events and the chunks they're in. */
+struct TraceBuffer
+{
+	TraceEvent *chunks[TRACE_MAX_CHUNKS];
+	atomic<int> count;
+	atomic<int> dropped;
+	int threadID;
+	const char *threadName;
+};
+
+atomic<bool> Trace::enabled(false);
+
+static mutex buffersLock;
+static vector<TraceBuffer *> buffers; //never freed, so a thread can finish before its events are written
+static chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+static THREAD_LOCAL TraceBuffer *threadBuffer = NULL;
+static THREAD_LOCAL const char *threadName = NULL;
+
+static TraceBuffer *GetThreadBuffer()
+{
+	if (!threadBuffer)
+	{
+		TraceBuffer *buffer = new TraceBuffer;
+		for (int i = 0; i < TRACE_MAX_CHUNKS; i++)
+			buffer->chunks[i] = NULL;
+		buffer->count.store(0, memory_order_relaxed);
+		buffer->dropped.store(0, memory_order_relaxed);
+		buffer->threadName = threadName;
+
+		lock_guard<mutex> hold(buffersLock);
+		buffer->threadID = buffers.size() + 1;
+		buffers.push_back(buffer);
+		threadBuffer = buffer;
+	}
+	return threadBuffer;
+}
+
+static bool Record(const char *category, const char *name, char phase, int limit)
+{
+	TraceBuffer *buffer = GetThreadBuffer();
+	int index = buffer->count.load(memory_order_relaxed);
+	if (index >= limit)
+	{
+		buffer->dropped.fetch_add(1, memory_order_relaxed);
+		return false;
+	}
+
+	TraceEvent *&chunk = buffer->chunks[index/TRACE_CHUNK_EVENTS];
+	if (!chunk)
+		chunk = new TraceEvent[TRACE_CHUNK_EVENTS];
+
+	TraceEvent &event = chunk[index % TRACE_CHUNK_EVENTS];
+	event.category = category;
+	event.name = name;
+	event.time = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - startTime).count();
+	event.phase = phase;
+	buffer->count.store(index + 1, memory_order_release);
+	return true;
+}
+
+void Trace::Start()
+{
+	enabled.store(true, memory_order_relaxed);
+}
+
+void Trace::Stop()
+{
+	enabled.store(false, memory_order_relaxed);
+}
+
+bool Trace::Begin(const char *category, const char *name)
+{
+	return Record(category, name, 'B', TRACE_MAX_CHUNKS*TRACE_CHUNK_EVENTS - TRACE_END_RESERVE);
+}
+
+void Trace::End(const char *category, const char *name)
+{
+	Record(category, name, 'E', TRACE_MAX_CHUNKS*TRACE_CHUNK_EVENTS);
+}
+
+void Trace::SetThreadName(const char *name)
+{
+	threadName = name;
+	if (threadBuffer)
+		threadBuffer->threadName = name;
+}
+
+//Names are literals from the code, but a quote or backslash would still break the file.
+static void WriteJSONString(ofstream &out, const char *text)
+{
+	out << '"';
+	for (const char *c = text; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+			out << '\\' << *c;
+		else if ((unsigned char)*c < ' ')
+			out << "\\u" << hex << setw(4) << setfill('0') << (int)*c << dec;
+		else
+			out << *c;
+	}
+	out << '"';
+}
+
+/*
+One object per event, in each thread's order, with times in microseconds.
+Every thread gets a metadata event naming it, so the timeline's rows say
+which thread is which.
+*/
+bool Trace::Write(string filename)
+{
+	vector<TraceBuffer *> threads;
+	{
+		lock_guard<mutex> hold(buffersLock);
+		threads = buffers;
+	}
+
+	ofstream out(filename.c_str());
+	out << "{\"traceEvents\":[";
+	bool first = true;
+	for (int i = 0; i < (int)threads.size(); i++)
+	{
+		TraceBuffer *buffer = threads[i];
+		if (buffer->threadName)
+		{
+			out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadID << ",\"args\":{\"name\":";
+			WriteJSONString(out, buffer->threadName);
+			out << "}}";
+			first = false;
+		}
+
+		int count = buffer->count.load(memory_order_acquire);
+		for (int j = 0; j < count; j++)
+		{
+			const TraceEvent &event = buffer->chunks[j/TRACE_CHUNK_EVENTS][j % TRACE_CHUNK_EVENTS];
+			out << (first ? "\n" : ",\n") << "{\"name\":";
+			WriteJSONString(out, event.name);
+			out << ",\"cat\":";
+			WriteJSONString(out, event.category);
+			out << ",\"ph\":\"" << event.phase << "\",\"ts\":" << event.time/1000 << '.' << setw(3) << setfill('0') << event.time % 1000;
+			out << ",\"pid\":1,\"tid\":" << buffer->threadID << "}";
+			first = false;
+		}
+	}
+	out << "\n],\"displayTimeUnit\":\"ms\"}" << endl;
+	return out.good();
+}
+
+int Trace::GetDropped()
+{
+	lock_guard<mutex> hold(buffersLock);
+	int dropped = 0;
+	for (int i = 0; i < (int)buffers.size(); i++)
+		dropped += buffers[i]->dropped.load(memory_order_relaxed);
+	return dropped;
+}
@@ -0,0 +1,84 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* Trace.h
+* Defines a timeline tracer: begin and end events from instrumented code on
+* every thread, written out as Chrome trace-event JSON for chrome://tracing
+* or Perfetto.
+*****************************************************************************/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <atomic>
+using namespace std;
+
+#define TRACE_CHUNK_EVENTS 4096 //a thread's buffer grows a chunk at a time...
+#define TRACE_MAX_CHUNKS 64 //...up to this many, after which its events are dropped and counted
+#define TRACE_END_RESERVE 256 //room kept for the ends of scopes already begun, so they always match
+
+/* Mark a block with TRACE_SCOPE("category", "Name") or a whole function with
+   TRACE_FUNCTION("category").  Names and categories have to be string
+   literals, since only the pointers are kept until the trace is written.
+
+   While tracing is off a scope is one relaxed load and a branch that always
+   goes the same way.  While it's on, each thread appends to its own buffer
+   without taking any lock; only a thread's first event takes one, to put
+   its buffer on the list Write goes through.  Write can run while other
+   threads are still tracing, and gets everything they'd finished by then. */
+class Trace
+{
+public:
+
+	static void Start();
+	static void Stop();
+	static bool IsEnabled() { return enabled.load(memory_order_relaxed); }
+
+	//Returns false if the event was dropped, so the matching End shouldn't be recorded either.
+	static bool Begin(const char *category, const char *name);
+	static void End(const char *category, const char *name);
+
+	//What this thread is called in the trace.  Costs nothing until the thread records something.
+	static void SetThreadName(const char *name);
+
+	//Everything recorded so far, as Chrome trace-event JSON.  Returns false if the file couldn't be written.
+	static bool Write(string filename);
+	static int GetDropped();
+
+private:
+
+	static atomic<bool> enabled;
+};
+
+class TraceScope
+{
+public:
+
+	TraceScope(const char *category, const char *name)
+	{
+		this->category = category;
+		this->name = name;
+		active = Trace::IsEnabled() && Trace::Begin(category, name);
+	}
+
+	~TraceScope()
+	{
+		if (active)
+			Trace::End(category, name);
+	}
+
+private:
+
+	const char *category, *name;
+	bool active; //the begin was recorded, so the end has to be, even if tracing stopped in between
+};
+
+#define TRACE_JOIN2(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN2(a, b)
+#define TRACE_SCOPE(category, name) TraceScope TRACE_JOIN(traceScope, __LINE__)(category, name)
+#define TRACE_FUNCTION(category) TRACE_SCOPE(category, __FUNCTION__)
+
+#endif
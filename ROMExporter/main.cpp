@@ -1,4 +1,8 @@
 #include "../OFLib/ROM.h"
+#include "../OFLib/Trace.h"
+#include <cstdio>
+#include <string>
+using namespace std;
 
 void Test(ROM &rom)
 {
@@ -7,10 +11,21 @@ void Test(ROM &rom)
 	//rom.DumpMapData("../Quests/FF1/Maps");
 }
 
-void main()
+//ROMExporter [--trace out.json] to see where an export spends its time, in chrome://tracing or Perfetto.
+void main(int argc, char **argv)
 {
+	string traceFilename;
+	if (argc == 3 && string(argv[1]) == "--trace")
+		traceFilename = argv[2];
+	Trace::SetThreadName("Exporter");
+	if (!traceFilename.empty())
+		Trace::Start();
+
 	ROM rom("finalfantasy1.nes");
-	rom.ExportFull();
+	rom.ExportIncremental();
+
+	if (!traceFilename.empty() && !Trace::Write(traceFilename))
+		printf("Unable to write %s\n", traceFilename.c_str());
 
 	//Test(rom);
 }
@@ -0,0 +1,66 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "FrameScheduler.h"
+#include <SDL/SDL.h>
+
+FrameScheduler::FrameScheduler(int updateRate, int frameRate)
+{
+	updateStep = 1000.0f/updateRate;
+	SetFrameRate(frameRate);
+	accumulator = 0;
+	lastTime = SDL_GetTicks();
+	vsync = false;
+	dirty = true; //the first frame always has to be drawn
+	presented = false;
+}
+
+void FrameScheduler::RequestVSync(bool enabled)
+{
+	SDL_GL_SetAttribute(SDL_GL_SWAP_CONTROL, enabled ? 1 : 0);
+}
+
+void FrameScheduler::DetectVSync()
+{
+	int swapControl = 0;
+	vsync = SDL_GL_GetAttribute(SDL_GL_SWAP_CONTROL, &swapControl) == 0 && swapControl > 0;
+}
+
+void FrameScheduler::SetFrameRate(int frameRate)
+{
+	frameStep = 1000.0f/frameRate;
+}
+
+//Work out how many fixed updates have come due since the last frame.
+int FrameScheduler::BeginFrame()
+{
+	unsigned int now = SDL_GetTicks();
+	accumulator += now - lastTime;
+	lastTime = now;
+	presented = false;
+
+	int updates = (int)(accumulator/updateStep);
+	if (updates > MAX_UPDATES_PER_FRAME)
+	{
+		updates = MAX_UPDATES_PER_FRAME;
+		accumulator = 0;
+	}
+	else
+		accumulator -= updates*updateStep;
+
+	return updates;
+}
+
+void FrameScheduler::Wait()
+{
+	//A synced swap already waited for the display.
+	if (vsync && presented)
+		return;
+
+	unsigned int elapsed = SDL_GetTicks() - lastTime;
+	if (elapsed < frameStep)
+		SDL_Delay((unsigned int)(frameStep - elapsed));
+}
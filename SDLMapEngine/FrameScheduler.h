@@ -0,0 +1,58 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* FrameScheduler.h
+* Defines the pacing of the game loop: game updates at a fixed rate, and
+* drawing at a target frame rate, only when something on screen changed.
+*****************************************************************************/
+
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#define DEFAULT_UPDATE_RATE 60 //updates per second
+#define DEFAULT_FRAME_RATE 60 //frames per second
+#define MAX_UPDATES_PER_FRAME 8 //after a long stall, drop the time instead of catching up
+
+/* Each pass through the loop:
+	int updates = scheduler.BeginFrame();   //run this many fixed steps
+	if (scheduler.NeedsPresent()) { draw and swap; scheduler.Presented(); }
+	scheduler.Wait();                        //sleep until the next frame is due
+
+   Anything that changes what's on screen calls MarkDirty().  While nothing
+   does, the loop just sleeps between frames instead of spinning. */
+class FrameScheduler
+{
+public:
+
+	FrameScheduler(int updateRate = DEFAULT_UPDATE_RATE, int frameRate = DEFAULT_FRAME_RATE);
+
+	//Ask the driver to sync swaps to the display.  Has to be called before the video mode is set.
+	static void RequestVSync(bool enabled);
+	//Find out whether the request was honored.  Call after the video mode is set.
+	void DetectVSync();
+	bool HasVSync() const { return vsync; }
+
+	void SetFrameRate(int frameRate);
+
+	int BeginFrame();
+	float GetUpdateStep() const { return updateStep/1000.0f; } //in seconds
+
+	void MarkDirty() { dirty = true; }
+	bool NeedsPresent() const { return dirty; }
+	void Presented() { dirty = false; presented = true; }
+
+	void Wait();
+
+private:
+
+	float updateStep, frameStep; //in milliseconds
+	float accumulator; //time not yet covered by updates
+	unsigned int lastTime; //when the last frame began
+	bool vsync;
+	bool dirty; //something changed since the last present
+	bool presented; //this frame was drawn
+};
+
+#endif
@@ -0,0 +1,206 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*****************************************************************************/
+
+#include "PerfOverlay.h"
+#include "../OFLib/MemoryTracker.h"
+#include <cstdio>
+#include <cstring>
+#include <SDL/SDL_opengl.h>
+using namespace std;
+
+#define PERF_MARGIN 8 //from the corner of the viewport to the panel
+#define PERF_PADDING 8 //from the edge of the panel to what's in it
+#define PERF_LINES 9
+#define PERF_LINE_HEIGHT (7*PERF_TEXT_SCALE)
+#define PERF_TEXT_COLUMNS 24 //characters in the longest line, e.g. "CPU 123.4 MB PEAK 234.5"
+#define PERF_PANEL_WIDTH (PERF_TEXT_COLUMNS*4*PERF_TEXT_SCALE + 2*PERF_PADDING) //wider than the graph
+#define PERF_PANEL_HEIGHT (PERF_LINES*PERF_LINE_HEIGHT + PERF_GRAPH_HEIGHT + 3*PERF_PADDING)
+
+//A 3x5 font with just what the overlay says.  Each row is three bits, the left column the highest.
+static const char GLYPH_CHARS[] = "0123456789.ABCDEFGHIKLMNOPRSTUW";
+static const unsigned char GLYPHS[][5] = {
+	{ 7, 5, 5, 5, 7 }, { 2, 6, 2, 2, 7 }, { 7, 1, 7, 4, 7 }, { 7, 1, 7, 1, 7 }, { 5, 5, 7, 1, 1 },
+	{ 7, 4, 7, 1, 7 }, { 7, 4, 7, 5, 7 }, { 7, 1, 1, 1, 1 }, { 7, 5, 7, 5, 7 }, { 7, 5, 7, 1, 7 },
+	{ 0, 0, 0, 0, 2 },
+	{ 2, 5, 7, 5, 5 }, { 6, 5, 6, 5, 6 }, { 7, 4, 4, 4, 7 }, { 6, 5, 5, 5, 6 }, { 7, 4, 6, 4, 7 },
+	{ 7, 4, 6, 4, 4 }, { 7, 4, 5, 5, 7 }, { 5, 5, 7, 5, 5 }, { 7, 2, 2, 2, 7 }, { 5, 5, 6, 5, 5 }, { 4, 4, 4, 4, 7 }, { 5, 7, 7, 5, 5 },
+	{ 6, 5, 5, 5, 5 }, { 2, 5, 5, 5, 2 }, { 6, 5, 6, 4, 4 }, { 6, 5, 6, 5, 5 }, { 3, 4, 2, 1, 6 },
+	{ 7, 2, 2, 2, 2 }, { 5, 5, 5, 5, 7 }, { 5, 5, 7, 7, 5 } };
+
+PerfOverlay::PerfOverlay()
+{
+	visible = false;
+	lastFrame = lastText = chrono::steady_clock::now();
+	memset(history, 0, sizeof(history));
+	next = 0;
+	frameStats.Reset();
+	peakUpload = 0;
+	overlayTime = 0;
+	textList = 0;
+}
+
+PerfOverlay::~PerfOverlay()
+{
+	if (textList)
+		glDeleteLists(textList, 1);
+}
+
+void PerfOverlay::BeginFrame()
+{
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	chrono::duration<float, milli> elapsed = now - lastFrame;
+	lastFrame = now;
+
+	history[next] = elapsed.count();
+	next = (next + 1 == PERF_HISTORY) ? 0 : next + 1;
+
+	frameStats = renderStats;
+	if (renderStats.uploadedBytes > peakUpload)
+		peakUpload = renderStats.uploadedBytes;
+}
+
+void PerfOverlay::Draw()
+{
+	if (!visible)
+		return;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	if (!textList || start - lastText >= chrono::milliseconds(PERF_TEXT_INTERVAL))
+	{
+		BuildText();
+		lastText = start;
+		peakUpload = 0;
+	}
+
+	//Screen pixels, with the origin at the top left of the panel and y going up.
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0.0, viewport[2], 0.0, viewport[3], -1.0, 1.0);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	glTranslatef(PERF_MARGIN, viewport[3] - PERF_MARGIN, 0.0);
+
+	glPushAttrib(GL_ENABLE_BIT|GL_CURRENT_BIT|GL_COLOR_BUFFER_BIT);
+	glDisable(GL_TEXTURE_2D);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	glBegin(GL_QUADS);
+		glColor4f(0.0f, 0.0f, 0.0f, 0.6f);
+		glVertex2i(0, 0);
+		glVertex2i(0, -PERF_PANEL_HEIGHT);
+		glVertex2i(PERF_PANEL_WIDTH, -PERF_PANEL_HEIGHT);
+		glVertex2i(PERF_PANEL_WIDTH, 0);
+
+		//Oldest frame on the left.  Green makes 60 fps, yellow 30, red neither.
+		int bottom = -PERF_PANEL_HEIGHT + PERF_PADDING;
+		for (int i = 0; i < PERF_HISTORY; i++)
+		{
+			float ms = history[(next + i) % PERF_HISTORY];
+			if (ms <= 1000.0f/60 + 0.5f)
+				glColor4f(0.2f, 0.9f, 0.2f, 1.0f);
+			else if (ms <= 1000.0f/30 + 0.5f)
+				glColor4f(0.9f, 0.9f, 0.2f, 1.0f);
+			else
+				glColor4f(0.9f, 0.2f, 0.2f, 1.0f);
+
+			float height = (ms < PERF_GRAPH_MAX ? ms : PERF_GRAPH_MAX)*PERF_GRAPH_HEIGHT/PERF_GRAPH_MAX;
+			int x = PERF_PADDING + 2*i;
+			glVertex2f(x, bottom);
+			glVertex2f(x, bottom + height);
+			glVertex2f(x + 2, bottom + height);
+			glVertex2f(x + 2, bottom);
+		}
+
+		//A line across at 60 fps.
+		float target = (1000.0f/60)*PERF_GRAPH_HEIGHT/PERF_GRAPH_MAX;
+		glColor4f(1.0f, 1.0f, 1.0f, 0.5f);
+		glVertex2f(PERF_PADDING, bottom + target);
+		glVertex2f(PERF_PADDING, bottom + target + 1);
+		glVertex2f(PERF_PADDING + 2*PERF_HISTORY, bottom + target + 1);
+		glVertex2f(PERF_PADDING + 2*PERF_HISTORY, bottom + target);
+	glEnd();
+
+	glCallList(textList);
+
+	glPopAttrib();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopMatrix();
+
+	chrono::duration<float, milli> elapsed = chrono::steady_clock::now() - start;
+	overlayTime = elapsed.count();
+}
+
+void PerfOverlay::BuildText()
+{
+	float current = history[next == 0 ? PERF_HISTORY - 1 : next - 1], worst = 0;
+	for (int i = 0; i < PERF_HISTORY; i++)
+		if (history[i] > worst)
+			worst = history[i];
+
+	char lines[PERF_LINES][32];
+	snprintf(lines[0], sizeof(lines[0]), "FRAME %.1f MS", current);
+	snprintf(lines[1], sizeof(lines[1]), "WORST %.1f MS", worst);
+	snprintf(lines[2], sizeof(lines[2]), "DRAWS %d", frameStats.drawCalls);
+	snprintf(lines[3], sizeof(lines[3]), "BINDS %d", frameStats.textureBinds);
+	snprintf(lines[4], sizeof(lines[4]), "TILES %d", frameStats.tilesDrawn);
+	snprintf(lines[5], sizeof(lines[5]), "UPLOAD %.1f KB", peakUpload/1024.0f);
+	snprintf(lines[6], sizeof(lines[6]), "HUD %.3f MS", overlayTime);
+
+	//Tracked asset memory, and the most it's been.
+	MemoryTracker &tracker = MemoryTracker::Get();
+	MemoryUsage cpu = tracker.GetUsage(MEMORY_TOTAL, MEMORY_CPU), gpu = tracker.GetUsage(MEMORY_TOTAL, MEMORY_GPU);
+	snprintf(lines[7], sizeof(lines[7]), "CPU %.1f MB PEAK %.1f", cpu.current/1048576.0f, cpu.peak/1048576.0f);
+	snprintf(lines[8], sizeof(lines[8]), "GPU %.1f MB PEAK %.1f", gpu.current/1048576.0f, gpu.peak/1048576.0f);
+
+	if (!textList)
+		textList = glGenLists(1);
+	glNewList(textList, GL_COMPILE);
+		glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+		glBegin(GL_QUADS);
+		for (int i = 0; i < PERF_LINES; i++)
+			AddText(lines[i], PERF_PADDING, -PERF_PADDING - i*PERF_LINE_HEIGHT);
+		glEnd();
+	glEndList();
+}
+
+//A quad for each run of lit pixels in a glyph row, with (x, y) the top left of the first character.  Has to be inside a glBegin(GL_QUADS).
+void PerfOverlay::AddText(const char *text, int x, int y)
+{
+	for (int i = 0; text[i]; i++)
+	{
+		const char *found = strchr(GLYPH_CHARS, text[i]);
+		if (text[i] == ' ' || !found)
+			continue;
+
+		const unsigned char *glyph = GLYPHS[found - GLYPH_CHARS];
+		for (int row = 0; row < 5; row++)
+		{
+			for (int col = 0; col < 3; col++)
+			{
+				if (!(glyph[row] & (4 >> col)))
+					continue;
+				int end = col + 1;
+				while (end < 3 && (glyph[row] & (4 >> end)))
+					end++;
+
+				int left = x + (4*i + col)*PERF_TEXT_SCALE, right = x + (4*i + end)*PERF_TEXT_SCALE;
+				int top = y - row*PERF_TEXT_SCALE;
+				glVertex2i(left, top);
+				glVertex2i(left, top - PERF_TEXT_SCALE);
+				glVertex2i(right, top - PERF_TEXT_SCALE);
+				glVertex2i(right, top);
+				col = end;
+			}
+		}
+	}
+}
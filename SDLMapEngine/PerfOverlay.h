@@ -0,0 +1,63 @@
+/*****************************************************************************
+* Original Fantasy
+* Author: Michael Bennett
+* Copyright 2007
+*
+* PerfOverlay.h
+* Defines the performance overlay drawn over the game while playtesting: a
+* rolling graph of frame times, the numbers from RenderStats, and the asset
+* memory the MemoryTracker knows about.
+*****************************************************************************/
+
+#ifndef PERFOVERLAY_H
+#define PERFOVERLAY_H
+
+#include "../OFLib/RenderStats.h"
+#include <chrono>
+using namespace std;
+
+#define PERF_HISTORY 120 //frames in the graph, two pixels each
+#define PERF_GRAPH_HEIGHT 64 //pixels
+#define PERF_GRAPH_MAX 50.0f //milliseconds at the top of the graph
+#define PERF_TEXT_INTERVAL 250 //milliseconds between refreshes of the numbers
+#define PERF_TEXT_SCALE 3 //screen pixels to a font pixel
+
+/* Each pass through the loop:
+	overlay.BeginFrame();   //times the last frame, before renderStats is reset
+	...
+	overlay.Draw();         //last thing before the swap
+
+   The graph is one batch of quads, redrawn every frame.  The numbers only
+   change a few times a second, so their text is kept in a display list and
+   only rebuilt then.  What the overlay draws isn't counted in renderStats. */
+class PerfOverlay
+{
+public:
+
+	PerfOverlay();
+	~PerfOverlay();
+
+	void Toggle() { visible = !visible; }
+	bool IsVisible() const { return visible; }
+
+	void BeginFrame();
+
+	//Draw over the top left of the current viewport.  Does nothing while hidden.
+	void Draw();
+
+private:
+
+	void BuildText();
+	void AddText(const char *text, int x, int y);
+
+	bool visible;
+	chrono::steady_clock::time_point lastFrame, lastText;
+	float history[PERF_HISTORY]; //frame times in milliseconds, a ring buffer
+	int next; //where the next frame time goes, and where the oldest one is
+	RenderStats frameStats; //from the last whole frame
+	size_t peakUpload; //the most uploaded in one frame since the text was built
+	float overlayTime; //milliseconds the last Draw took
+	unsigned int textList;
+};
+
+#endif
@@ -3,13 +3,40 @@
 #include <exception>
 #include <string>
 #include <fstream>
-#include "PerfTimer.h"
+#include <cmath>
+#include <cstdlib>
+#include "FrameScheduler.h"
+#include "PerfOverlay.h"
 #include "mtxlib.h"
 #include "../OFLib/Map.h"
+#include "../OFLib/MapExits.h"
+#include "../OFLib/MemoryTracker.h"
+#include "../OFLib/Trace.h"
+#include <vector>
 using namespace std;
 
-Map *myMap;
+//Somewhere to go back to when the player steps on a warp.
+struct Visit
+{
+	string mapFilename;
+	int col, row;
+	bool inRoom;
+};
+
+Map *myMap = NULL;
+Map *nextMap = NULL; //still loading, shown once it's ready
+string mapFilename, nextMapFilename;
+int arriveCol = -1, arriveRow = -1; //where the camera goes on the next map, -1 to stay put
+bool inRoom = false, arriveInRoom = false;
+vector<Visit> warpStack;
+AssetLoader *loader = NULL;
+AssetCache *assets = NULL;
+MapExits *exits = NULL;
+ExitPrefetcher *prefetcher = NULL;
 float centerX = 0, centerY = 0;
+int moveX = 0, moveY = 0; //camera moves waiting for the next update
+FrameScheduler *scheduler = NULL; //made once SDL is up, since it reads the clock
+PerfOverlay *overlay = NULL;
 bool stop = false;
 SDL_Surface *screen = NULL;
 
@@ -56,19 +83,107 @@ void HandleEvent(const SDL_Event event)
 	if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F5)
 		SaveScreenshot();
 
+	if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F4)
+	{
+		ofstream reportFile("memory.txt");
+		MemoryTracker::Get().Report(reportFile);
+	}
+
+	//Pick up tiles and maps changed on disk.  What's on screen now stays until it's left and entered again.
+	if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F6)
+		assets->CheckFiles();
+
+	if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F3)
+	{
+		overlay->Toggle();
+		scheduler->MarkDirty();
+	}
+
 	if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_w)
-		centerY += 1;
+		moveY += 1;
 	if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_a)
-		centerX -= 1;
+		moveX -= 1;
 	if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_s)
-		centerY -= 1;
+		moveY -= 1;
 	if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_d)
-		centerX += 1;
+		moveX += 1;
+
+	//The window was uncovered or came back to the front, so what's there is stale.
+	if (event.type == SDL_VIDEOEXPOSE || event.type == SDL_ACTIVEEVENT)
+		scheduler->MarkDirty();
+}
+
+void LoadMap(string filename, int col = -1, int row = -1, bool room = false)
+{
+	//Anything already on the way has to finish before it can be thrown away.
+	if (nextMap)
+		return;
+	nextMap = assets->GetMap(filename);
+	nextMapFilename = filename;
+	arriveCol = col;
+	arriveRow = row;
+	arriveInRoom = room;
+}
+
+//Find the tile the camera is on, as a column and row from the top of the map.
+void GetCameraTile(int &col, int &row)
+{
+	int width = myMap->GetWidth(), height = myMap->GetHeight();
+	int tileIndex = MapTileIndex(floor(centerX), floor(centerY), width, height);
+	col = tileIndex % width;
+	row = tileIndex / width;
+}
+
+void TakeExit(const MapExit &exit, int col, int row)
+{
+	if (exit.type == EXIT_WARP)
+	{
+		if (warpStack.empty())
+			return;
+		Visit back = warpStack.back();
+		warpStack.pop_back();
+		LoadMap(back.mapFilename, back.col, back.row, back.inRoom);
+		return;
+	}
+
+	//Going out to the overworld leaves every warp behind.
+	if (exit.type == EXIT_OVERWORLD)
+		warpStack.clear();
+	else
+	{
+		Visit here = { mapFilename, col, row, inRoom };
+		warpStack.push_back(here);
+	}
+	LoadMap(exit.destination, exit.destCol, exit.destRow, exit.inRoom);
+}
+
+//One fixed step of game time.
+void Update(float seconds)
+{
+	TRACE_SCOPE("engine", "Update");
+	if (moveX != 0 || moveY != 0)
+	{
+		centerX += moveX;
+		centerY += moveY;
+		moveX = moveY = 0;
+		scheduler->MarkDirty();
 
+		if (myMap && !nextMap)
+		{
+			int col, row;
+			GetCameraTile(col, row);
+			prefetcher->Update(col, row);
+
+			const MapExit *exit = exits->FindExit(mapFilename, col, row);
+			if (exit)
+				TakeExit(*exit, col, row);
+		}
+	}
 }
 
 void Draw()
 {
+	TRACE_SCOPE("engine", "Draw");
 	glClear(GL_COLOR_BUFFER_BIT);
 
 	glMatrixMode(GL_PROJECTION);
@@ -79,7 +194,10 @@ void Draw()
 	glLoadIdentity();
 	glTranslatef(-centerX, -centerY, 0.0);
 
-	myMap->Draw(centerX, centerY);
+	if (myMap)
+		myMap->Draw(centerX, centerY);
+
+	overlay->Draw();
 
 	SDL_GL_SwapBuffers();
 }
@@ -88,23 +206,61 @@ void GameLoop()
 {
 	SDL_Event event;
 
-	PerfTimer timer;
-	timer.Reset();
-	timer.Start();
-
 	while (!stop)
 	{
+		TRACE_SCOPE("engine", "Frame");
+
+		//The counters cover everything from here to the swap: loading, uploads and drawing.
+		overlay->BeginFrame();
+		renderStats.Reset();
+
 		while (SDL_PollEvent(&event))
 		{
 			HandleEvent(event);
 		}
 
-		timer.Stop();
-		float time = timer.GetDurationSeconds();
-		timer.Reset();
-		timer.Start();
+		int updates = scheduler->BeginFrame();
+		for (int i = 0; i < updates; i++)
+			Update(scheduler->GetUpdateStep());
+
+		//A slice of whatever's loading, then switch maps once it's all there.
+		loader->Upload(DEFAULT_UPLOAD_BUDGET);
+		assets->Trim();
+		if (nextMap && nextMap->IsReady())
+		{
+			if (myMap)
+				assets->Release(myMap);
+			myMap = nextMap;
+			mapFilename = nextMapFilename;
+			nextMap = NULL;
+			if (arriveCol >= 0)
+			{
+				centerX = arriveCol;
+				centerY = myMap->GetHeight() - 1 - arriveRow;
+			}
+			inRoom = arriveInRoom;
+			myMap->SetInRoom(inRoom);
+			scheduler->MarkDirty();
+
+			//Start on whatever's near where we came in.
+			int col, row;
+			GetCameraTile(col, row);
+			prefetcher->SetMap(mapFilename, myMap->GetWidth(), myMap->GetHeight());
+			prefetcher->Update(col, row);
+		}
+
+		//The graph moves every frame, so while it's up every frame is drawn.
+		if (overlay->IsVisible())
+			scheduler->MarkDirty();
 
-		Draw();
+		//Nothing changed, so the last frame is still on screen.
+		if (scheduler->NeedsPresent())
+		{
+			Draw();
+			scheduler->Presented();
+		}
+
+		scheduler->Wait();
 	}
 }
 
@@ -113,6 +269,7 @@ void InitGL()
 	SDL_GL_SetAttribute(SDL_GL_BUFFER_SIZE, 32);
 	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 16);
 	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+	FrameScheduler::RequestVSync(true);
 
 	int width = 1920, height = 1200;
 	screen = SDL_SetVideoMode(width, height, 32, SDL_OPENGL|SDL_FULLSCREEN);
@@ -121,6 +278,7 @@ void InitGL()
 		printf("Unable to set video mode: %s\n", SDL_GetError());
 		exit(1);
 	}
+	scheduler->DetectVSync();
 
 	glViewport(275, 0, 1370, 1200);
 
@@ -135,20 +293,52 @@ void Initialize()
 		exit(1);
 	}
 	atexit(SDL_Quit);
+	scheduler = new FrameScheduler();
 
 	InitGL();
 }
 
-void LoadMap()
+/* Memory budgets in MB, e.g. --gpu-budget 32 --cpu-budget 16 for a machine
+   short on memory, and --trace file to record a timeline of the whole run
+   for chrome://tracing or Perfetto.  Returns the trace's filename, if any. */
+string ReadOptions(int argc, char **argv)
 {
-	myMap = new Map("Elfland Castle.map");
+	string traceFilename;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		string arg = argv[i];
+		size_t bytes = (size_t)atoi(argv[i + 1])*1024*1024;
+		if (arg == "--trace")
+			traceFilename = argv[i + 1];
+		else if (arg == "--cpu-budget")
+			MemoryTracker::Get().SetBudget(MEMORY_TOTAL, MEMORY_CPU, bytes);
+		else if (arg == "--gpu-budget")
+			MemoryTracker::Get().SetBudget(MEMORY_TOTAL, MEMORY_GPU, bytes);
+		else if (arg == "--cache-budget")
+			assets->SetBudget(bytes);
+		else
+			continue;
+		i++;
+	}
+	return traceFilename;
 }
 
 int main(int argc, char **argv)
 {
 	Initialize();
-	LoadMap();
+	overlay = new PerfOverlay();
+	loader = new AssetLoader();
+	assets = new AssetCache(DEFAULT_ASSET_BUDGET, loader);
+	string traceFilename = ReadOptions(argc, argv);
+	Trace::SetThreadName("Main");
+	if (!traceFilename.empty())
+		Trace::Start();
+	exits = new MapExits();
+	prefetcher = new ExitPrefetcher(*assets, *exits);
+	LoadMap("Elfland Castle.map");
 	GameLoop();
 
+	if (!traceFilename.empty() && !Trace::Write(traceFilename))
+		printf("Unable to write %s\n", traceFilename.c_str());
 	return 0;
 }